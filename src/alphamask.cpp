@@ -2,10 +2,15 @@
 //	Displays resulting image when done & exports to file
 //
 //	Usage: alphamask input.(img) output.png [3 floats HSV of target] [3 floats HSV of tolerance]
+//	       alphamask --batch (-j jobs) (--target h s v) (--fuzz h s v) -o [pattern] [inputs...]
+//	       alphamask --rawcache-fill [inputs...] | --rawcache-clear
 //	Input can be any image type, output will be png
 //
 //	CPSC 4040 | Owen Book | October 2022
 #include "gloiioFuncs.h"
+#include "gloiioDisplay.h"
+#include "gloiioBatch.h"
+#include "gloiioRaw.h"
 #include <OpenImageIO/imageio.h>
 #include <iostream>
 #include <string>
@@ -39,19 +44,8 @@ void draw(){
 	//clear and make black background
 	glClearColor(0,0,0,1);
 	glClear(GL_COLOR_BUFFER_BIT);
-	if (imageCache.size() > 0) {
-		//display alphamasked image not the original input via blending
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glEnable(GL_BLEND);
-		//get image spec & current window size
-		ImageSpec* spec = &imageCache[cacheIndex].spec;
-		glPixelZoom(1.0,1.0);
-		glPixelStorei(GL_UNPACK_ALIGNMENT, 1); //Parrot Fixer 2000
-		glRasterPos2i(0,0); //draw from bottom left
-		//draw image
-		glDrawPixels(spec->width,spec->height,GL_RGBA,GL_UNSIGNED_BYTE,&imageCache[cacheIndex].pixels[0]);
-		glDisable(GL_BLEND);
-	}
+	//the image, uploading whatever changed since the last draw (see gloiioDisplay.h)
+	displayDraw();
 	//flush to viewport
 	glFlush();
 }
@@ -96,17 +90,59 @@ void handleReshape(int w, int h){
   gluOrtho2D(0, w, 0, h);
 }
 
-/* timer function to make the OS always update the window 
-	(fixes hang on launch...)*/
-void timer( int value )
-{
-    glutPostRedisplay();
-    glutTimerFunc( 33, timer, 0 );
+/* headless mode: mask every input and write it out, no window at all */
+int batchMain(int argc, char* argv[]) {
+	pxHSV target = linkHSV(120.0, 0.7, 0.7); //fallback
+	pxHSV fuzz = linkHSV(20.0, 0.2, 0.2); //fallback
+	int jobs = 0;
+	string pattern;
+	vector<string> args;
+	for (int i=1; i<argc; i++) {
+		string arg = string(argv[i]);
+		if (isBatchFlag(arg)) {
+			continue;
+		}
+		else if (arg == "-j" && i+1 < argc) {
+			jobs = stoi(argv[++i],nullptr);
+		}
+		else if (arg == "-o" && i+1 < argc) {
+			pattern = string(argv[++i]);
+		}
+		else if (arg == "--target" && i+3 < argc) {
+			target = linkHSV(stod(argv[i+1],nullptr),stod(argv[i+2],nullptr),stod(argv[i+3],nullptr));
+			i += 3;
+		}
+		else if (arg == "--fuzz" && i+3 < argc) {
+			fuzz = linkHSV(stod(argv[i+1],nullptr),stod(argv[i+2],nullptr),stod(argv[i+3],nullptr));
+			i += 3;
+		}
+		else {
+			args.push_back(arg);
+		}
+	}
+	if (args.empty() || pattern.empty()) {
+		cerr << "usage: alphamask --batch (-j jobs) (--target h s v) (--fuzz h s v) -o [pattern] [inputs...]" << endl;
+		return 1;
+	}
+	int failed = runBatch(expandInputs(args), pattern, jobs, [&](ImageRGBA image) {
+		chromaKey(image,target,fuzz.hue,fuzz.saturation,fuzz.value);
+		return image;
+	}, ".png");
+	return (failed > 0)? 1 : 0;
 }
 
 /* main control method that sets up the GL environment
 	and handles command line arguments */
 int main(int argc, char* argv[]){
+	for (int i=1; i<argc; i++) {
+		if (isBatchFlag(string(argv[i]))) {
+			return batchMain(argc, argv);
+		}
+		if (isRawCacheCommand(string(argv[i]))) {
+			return rawCacheMain(argc, argv);
+		}
+	}
+
 	//read arguments as filenames and attempt to read requested input file
 	if (argc >= 3) {
 		string instr = string(argv[1]);
@@ -136,6 +172,8 @@ int main(int argc, char* argv[]){
 	}
 	else {
 		cerr << "usage: alphamask [input] [output].png" << endl;
+		cerr << "       alphamask --batch (-j jobs) (--target h s v) (--fuzz h s v) -o [pattern] [inputs...]" << endl;
+		cerr << "       alphamask --rawcache-fill [inputs...] | --rawcache-clear" << endl;
 		exit(1);
 	}
 
@@ -147,15 +185,17 @@ int main(int argc, char* argv[]){
 	glutInitWindowSize(DEFAULT_WIDTH, DEFAULT_HEIGHT);
 	glutCreateWindow("alphamask Result");
 
-	//if there is an image already loaded, set the resolution to fit it
+	//if there is an image already loaded, set the resolution to fit it & show it
 	refitWindow();
+	if (imageCache.size() > 0) {
+		displayImage(imageCache[cacheIndex]);
+	}
 	
 	// set up the callback routines to be called when glutMainLoop() detects
 	// an event
 	glutDisplayFunc(draw);	  // display callback
 	glutKeyboardFunc(handleKey);	  // keyboard callback
 	glutReshapeFunc(handleReshape); // window resize callback
-	glutTimerFunc(0, timer, 0); //timer func to force redraws
 
 	// Routine that loops forever looking for events. It calls the registered
 	// callback routine to handle each event that is detected
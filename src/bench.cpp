@@ -0,0 +1,319 @@
+//	bench: headless benchmarks for the image kernels in gloiioFuncs
+//
+//	Usage: bench (-t threads) (-m mode) (-r reps) (-s sizes) (--only name) (-o results.json) (--compare old.json (--tolerance pct))
+//	times readImage & writeImage on every image under img/, and invert, noisify,
+//	chromaKey, compose & convolve (with every filters/*.filt) on square images of
+//	each size in -s (comma separated, 512,1024,2048 by default) made from the
+//	biggest image there. prints MP/s, ns/pixel & percentile times per kernel,
+//	-o also writes them as JSON, and --compare checks them against an old run
+//	(exits 1 if anything's more than --tolerance percent slower, 10 by default)
+//	See README.md for more details
+//
+//	CPSC 4040 | Owen Book
+#include "gloiioFuncs.h"
+#include "gloiioPool.h"
+#include "gloiioSIMD.h"
+#include "gloiioBatch.h"
+#include "gloiioRaw.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace std;
+OIIO_NAMESPACE_USING;
+
+//where the inputs come from
+#define BENCH_IMAGES {"img/*/*.*", "img/*/*/*.*"}
+#define BENCH_FILTERS "filters/*.filt"
+//timed runs per case (after one untimed warmup run)
+#define BENCH_REPS 5
+
+//one kernel run on one input, reps times over
+typedef struct bench_result_t {
+	string kernel; //readImage, convolve, ...
+	string variant; //file, filter or mode it was run with
+	int width, height;
+	vector<double> ms; //every timed run, sorted
+} BenchResult;
+
+static vector<BenchResult> results;
+static int reps = BENCH_REPS;
+static string only; //only run kernels with this in their name
+static string modeName = "auto"; //convolve mode, as named on the command line (or GLOIIO_CONVOLVE)
+
+/* nearest rank percentile of sorted times */
+double percentile(const vector<double>& sorted, double pct) {
+	if (sorted.empty()) { return 0.0; }
+	int rank = (int)ceil(pct/100.0*sorted.size());
+	return sorted[clampInt(rank-1, 0, sorted.size()-1)];
+}
+
+/* median time in ms, and what that is per megapixel & per pixel */
+double medianMs(const BenchResult& r) { return percentile(r.ms, 50); }
+double mpPerSec(const BenchResult& r) { return (double)r.width*r.height/1e6 / (medianMs(r)/1000.0); }
+double nsPerPx(const BenchResult& r) { return medianMs(r)*1e6 / ((double)r.width*r.height); }
+
+/*	runs body reps+1 times (the first one untimed, to warm up caches & the pool),
+ *	with setup before each run left out of the timing. prints & keeps the result */
+void timeKernel(string kernel, string variant, int width, int height, function<void()> setup, function<void()> body) {
+	if (!only.empty() && kernel.find(only) == string::npos) { return; }
+	typedef chrono::steady_clock clk;
+	BenchResult r = {kernel, variant, width, height, {}};
+	for (int i=0; i<=reps; i++) {
+		setup();
+		clk::time_point t0 = clk::now();
+		body();
+		double ms = chrono::duration<double,milli>(clk::now()-t0).count();
+		if (i > 0) { r.ms.push_back(ms); }
+	}
+	sort(r.ms.begin(), r.ms.end());
+	cout << left << setw(11) << kernel << setw(28) << variant.substr(0, 27)
+		<< right << setw(5) << width << "x" << left << setw(5) << height << right << fixed << setprecision(2)
+		<< setw(10) << medianMs(r) << setw(10) << percentile(r.ms, 90) << setw(10) << r.ms.front()
+		<< setw(10) << mpPerSec(r) << setw(10) << nsPerPx(r) << endl;
+	results.push_back(r);
+}
+
+/* square image size x size, nearest neighbor scaled from source */
+ImageRGBA synthImage(const ImageRGBA& source, int size) {
+	ImageRGBA image(ImageSpec(size, size, 4, TypeDesc::UINT8));
+	int sw = source.spec.width, sh = source.spec.height;
+	parallelRows(0, size, [&](int y0, int y1) {
+		for (int y=y0; y<y1; y++) {
+			for (int x=0; x<size; x++) {
+				image.pixels[contigIndex(y,x,size)] = source.pixels[contigIndex((long)y*sh/size, (long)x*sw/size, sw)];
+			}
+		}
+	});
+	return image;
+}
+
+/* runs fn with cout swallowed (readImage & writeImage talk a lot) */
+void quietly(function<void()> fn) {
+	streambuf* old = cout.rdbuf(nullptr);
+	try {
+		fn();
+	}
+	catch (...) {
+		cout.rdbuf(old);
+		cout.clear();
+		throw;
+	}
+	cout.rdbuf(old);
+	cout.clear();
+}
+
+/* s with quotes & backslashes escaped for a JSON string */
+string jsonString(string s) {
+	string out = "\"";
+	for (char c : s) {
+		if (c == '"' || c == '\\') { out += '\\'; }
+		out += c;
+	}
+	return out + "\"";
+}
+
+/*	writes every result as JSON, one result object per line so runs diff nicely
+ *	(and so --compare can read them back without a JSON library) */
+bool writeResults(string filename) {
+	ofstream out(filename);
+	if (!out) {
+		cerr << "could not open " << filename << " for writing" << endl;
+		return false;
+	}
+	out << "{\"threads\": " << getThreadCount() << ", \"simd\": " << jsonString(simdName(simdLevel()))
+		<< ", \"convolve_mode\": " << jsonString(modeName) << ", \"reps\": " << reps << ", \"results\": [" << endl;
+	out << setprecision(6);
+	for (size_t i=0; i<results.size(); i++) {
+		BenchResult& r = results[i];
+		out << "{\"kernel\": " << jsonString(r.kernel) << ", \"variant\": " << jsonString(r.variant)
+			<< ", \"width\": " << r.width << ", \"height\": " << r.height
+			<< ", \"min_ms\": " << r.ms.front() << ", \"p50_ms\": " << medianMs(r)
+			<< ", \"p90_ms\": " << percentile(r.ms, 90) << ", \"p99_ms\": " << percentile(r.ms, 99)
+			<< ", \"max_ms\": " << r.ms.back() << ", \"mp_per_s\": " << mpPerSec(r)
+			<< ", \"ns_per_px\": " << nsPerPx(r) << "}" << ((i+1 < results.size())? "," : "") << endl;
+	}
+	out << "]}" << endl;
+	cout << "wrote " << results.size() << " results to " << filename << endl;
+	return true;
+}
+
+/* value of "key": in one result line of writeResults' output ("" if it's not there) */
+string jsonField(const string& line, string key) {
+	size_t at = line.find("\"" + key + "\": ");
+	if (at == string::npos) { return ""; }
+	at += key.size()+4;
+	if (line[at] == '"') {
+		string val;
+		for (size_t i=at+1; i<line.size() && line[i] != '"'; i++) {
+			if (line[i] == '\\') { i++; }
+			val += line[i];
+		}
+		return val;
+	}
+	return line.substr(at, line.find_first_of(",}", at)-at);
+}
+
+/*	compares median times against an old run's JSON: prints every case both have
+ *	and returns how many got more than tolerance percent slower */
+int compareResults(string filename, double tolerance) {
+	ifstream in(filename);
+	if (!in) {
+		cerr << "could not open " << filename << endl;
+		return -1;
+	}
+	int slower = 0, matched = 0;
+	string line;
+	cout << endl << "compared to " << filename << " (median times):" << endl;
+	while (getline(in, line)) {
+		if (jsonField(line, "kernel").empty()) { continue; }
+		for (BenchResult& r : results) {
+			if (r.kernel != jsonField(line, "kernel") || r.variant != jsonField(line, "variant")
+				|| to_string(r.width) != jsonField(line, "width") || to_string(r.height) != jsonField(line, "height")) {
+				continue;
+			}
+			double old = stod(jsonField(line, "p50_ms"));
+			double change = (medianMs(r)/old - 1.0)*100.0;
+			bool bad = change > tolerance;
+			slower += bad? 1 : 0;
+			matched++;
+			cout << left << setw(11) << r.kernel << setw(28) << r.variant.substr(0, 27)
+				<< right << setw(5) << r.width << "x" << left << setw(5) << r.height << right << fixed << setprecision(2)
+				<< setw(10) << old << " -> " << setw(10) << medianMs(r) << " ms " << showpos << setw(8) << change << "%" << noshowpos
+				<< (bad? "  SLOWER" : "") << endl;
+		}
+	}
+	cout << matched << " cases compared, " << slower << " more than " << tolerance << "% slower" << endl;
+	return slower;
+}
+
+int main(int argc, char* argv[]) {
+	vector<int> sizes = {512, 1024, 2048};
+	if (getenv(CONVOLVE_ENV)) {
+		modeName = string(getenv(CONVOLVE_ENV));
+	}
+	string jsonOut, baseline;
+	double tolerance = 10.0;
+	for (int i=1; i<argc; i++) {
+		string arg = string(argv[i]);
+		if ((arg == "-t" || arg == "--threads") && i+1 < argc) {
+			setThreadCount(stoi(argv[++i],nullptr));
+		}
+		else if ((arg == "-m" || arg == "--mode") && i+1 < argc) {
+			modeName = string(argv[++i]);
+			setConvolveMode(convolveModeFromName(modeName));
+		}
+		else if ((arg == "-r" || arg == "--reps") && i+1 < argc) {
+			reps = max(1, stoi(argv[++i],nullptr));
+		}
+		else if ((arg == "-s" || arg == "--sizes") && i+1 < argc) {
+			sizes.clear();
+			stringstream list(argv[++i]);
+			string size;
+			while (getline(list, size, ',')) { sizes.push_back(stoi(size,nullptr)); }
+		}
+		else if (arg == "--only" && i+1 < argc) {
+			only = string(argv[++i]);
+		}
+		else if (arg == "-o" && i+1 < argc) {
+			jsonOut = string(argv[++i]);
+		}
+		else if (arg == "--compare" && i+1 < argc) {
+			baseline = string(argv[++i]);
+		}
+		else if (arg == "--tolerance" && i+1 < argc) {
+			tolerance = stod(argv[++i],nullptr);
+		}
+		else {
+			cerr << "usage: bench (-t threads) (-m mode) (-r reps) (-s sizes) (--only name) (-o results.json) (--compare old.json (--tolerance pct))" << endl;
+			exit(1);
+		}
+	}
+	setenv(RAW_CACHE_ENV, "off", 1); //readImage should really decode
+
+	vector<string> images = expandInputs(BENCH_IMAGES);
+	vector<string> filters = expandInputs({BENCH_FILTERS});
+	if (images.empty()) {
+		cerr << "no images found, run bench from the top of the repo" << endl;
+		exit(1);
+	}
+	cout << getThreadCount() << " threads, " << simdName(simdLevel()) << ", convolve mode "
+		<< modeName << ", " << reps << " runs per case" << endl;
+	cout << left << setw(11) << "kernel" << setw(28) << "variant" << setw(11) << "size" << right
+		<< setw(10) << "p50 ms" << setw(10) << "p90 ms" << setw(10) << "min ms"
+		<< setw(10) << "MP/s" << setw(10) << "ns/px" << endl;
+
+	//decoding & encoding the real files (the biggest one is what the synthetic images are made of)
+	ImageRGBA biggest;
+	string tempOut = "/tmp/gloiio_bench_" + to_string(getpid()) + ".png";
+	for (string& file : images) {
+		ImageRGBA image;
+		try {
+			quietly([&]{ image = readImage(file); });
+		}
+		catch (exception& e) {
+			continue; //not an image (error message is inside readImage already)
+		}
+		int w = image.spec.width, h = image.spec.height;
+		timeKernel("readImage", file, w, h, []{}, [&]{ quietly([&]{ readImage(file); }); });
+		timeKernel("writeImage", file, w, h, []{}, [&]{ quietly([&]{ writeImage(tempOut, image); }); });
+		if ((size_t)w*h > (size_t)biggest.spec.width*biggest.spec.height) {
+			biggest = std::move(image);
+		}
+	}
+	remove(tempOut.c_str());
+	if (!biggest.pixels) {
+		cerr << "none of the images could be read" << endl;
+		exit(1);
+	}
+
+	//the pixel kernels, each run on a fresh copy of the same synthetic image
+	for (int size : sizes) {
+		ImageRGBA pristine = synthImage(biggest, size);
+		ImageRGBA image = cloneImage(pristine);
+		//foreground for compose: the image upside down, fading out left to right
+		ImageRGBA layer = cloneImage(pristine);
+		for (int y=0; y<size; y++) {
+			for (int x=0; x<size; x++) {
+				layer.pixels[contigIndex(y,x,size)] = pristine.pixels[contigIndex(size-1-y,x,size)];
+				layer.pixels[contigIndex(y,x,size)].alpha = 255 - x*255/size;
+			}
+		}
+		auto reset = [&]{ copyPixels(pristine, image); };
+
+		timeKernel("invert", "", size, size, reset, [&]{ invert(image); });
+		timeKernel("noisify", "1/5", size, size, reset, [&]{ noisify(image, 5, 1); });
+		timeKernel("chromaKey", "green", size, size, reset, [&]{
+			chromaKey(image, linkHSV(120.0, 0.7, 0.7), 20.0, 0.2, 0.2);
+		});
+		timeKernel("compose", "over", size, size, reset, [&]{ compose(layer, image, 0, 0, BLEND_OVER); });
+		timeKernel("compose", "multiply", size, size, reset, [&]{ compose(layer, image, 0, 0, BLEND_MULTIPLY); });
+		for (string& file : filters) {
+			RawFilter filt;
+			try {
+				filt = readFilter(file);
+			}
+			catch (exception& e) {
+				continue; //(error message is inside readFilter already)
+			}
+			timeKernel("convolve", file, size, size, reset, [&]{ convolve(filt, image); });
+			discardRawFilter(filt);
+		}
+	}
+
+	if (!jsonOut.empty() && !writeResults(jsonOut)) {
+		return 1;
+	}
+	if (!baseline.empty()) {
+		int slower = compareResults(baseline, tolerance);
+		return (slower != 0)? 1 : 0;
+	}
+	return 0;
+}
@@ -1,14 +1,21 @@
 //	OpenGL/GLUT Program to do simple image composition of image A over image B
 //	Displays resulting image when done with optional export to file
 //
-//	Usage: compose [foreground].png [background] (output)
+//	Usage: compose (-m mode) (--at x y) (--key h s v (--fuzz h s v)) [foreground].png [background] (output)
+//	       compose --batch (-j jobs) (-m mode) (--at x y) (--key h s v (--fuzz h s v)) [background] -o [pattern] [foregrounds...]
+//	       compose --rawcache-fill [inputs...] | --rawcache-clear
+//	-m picks how they're combined: over (default), in, out, atop, xor, plus, multiply, screen, add, difference
+//	--at puts the foreground's top left corner x,y pixels from the background's top left (default 0 0)
+//	--key masks the foreground like alphamask on the way (no need to run alphamask first)
 //	Inputs can be any image type, but it's recommended the foreground is from running alphamask.
-//	Foreground must be same size or smaller than background!
-//	There is currently no function to position the foreground image elsewhere.
+//	Any part of the foreground that ends up off the background is cut off.
 //
 //	CPSC 4040 | Owen Book | October 2022
 
 #include "gloiioFuncs.h"
+#include "gloiioDisplay.h"
+#include "gloiioBatch.h"
+#include "gloiioRaw.h"
 #include <OpenImageIO/imageio.h>
 #include <iostream>
 #include <string>
@@ -34,6 +41,15 @@ OIIO_NAMESPACE_USING
 static vector<ImageRGBA> imageCache;
 //current index in vector to attempt to load (probably won't be touched in this program)
 static int cacheIndex = 0;
+//greenscreen the foreground on the fly? (--key/--fuzz)
+static bool keyed = false;
+static pxHSV keyTarget = linkHSV(120.0, 0.7, 0.7); //fallback, same as alphamask
+static pxHSV keyFuzz = linkHSV(20.0, 0.2, 0.2); //fallback, same as alphamask
+//where the foreground's top left corner goes on the background (--at)
+static int placeX = 0;
+static int placeY = 0;
+//how the foreground & background are combined (-m)
+static BlendMode blendMode = BLEND_OVER;
 
 /** OPENGL FUNCTIONS **/
 /* main display callback: displays the image of current index from imageCache. 
@@ -42,19 +58,8 @@ void draw(){
 	//clear and make black background
 	glClearColor(0,0,0,1);
 	glClear(GL_COLOR_BUFFER_BIT);
-	if (imageCache.size() > 0) {
-		//display alphamasked image properly via blending
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glEnable(GL_BLEND);
-		//get image spec & current window size
-		ImageSpec* spec = &imageCache[cacheIndex].spec;
-		glPixelZoom(1.0,1.0);
-		glPixelStorei(GL_UNPACK_ALIGNMENT, 1); //Parrot Fixer 2000
-		glRasterPos2i(0,0); //draw from bottom left
-		//draw image
-		glDrawPixels(spec->width,spec->height,GL_RGBA,GL_UNSIGNED_BYTE,&imageCache[cacheIndex].pixels[0]);
-		glDisable(GL_BLEND);
-	}
+	//the image, uploading whatever changed since the last draw (see gloiioDisplay.h)
+	displayDraw();
 	//flush to viewport
 	glFlush();
 }
@@ -99,35 +104,122 @@ void handleReshape(int w, int h){
   gluOrtho2D(0, w, 0, h);
 }
 
-/* timer function to make the OS always update the window 
-	(fixes hang on launch...)*/
-void timer( int value )
-{
-    glutPostRedisplay();
-    glutTimerFunc( 33, timer, 0 );
+/* pulls -m mode / --at x y / --key h s v / --fuzz h s v out of the arguments at i (moving i past them)
+ * returns false if argv[i] isn't one of them */
+bool readComposeFlag(int argc, char* argv[], int& i) {
+	string arg = string(argv[i]);
+	if ((arg == "-m" || arg == "--mode") && i+1 < argc) {
+		blendMode = blendModeFromName(argv[++i]);
+		return true;
+	}
+	if (arg == "--at" && i+2 < argc) {
+		placeX = stoi(argv[i+1],nullptr);
+		placeY = stoi(argv[i+2],nullptr);
+		i += 2;
+		return true;
+	}
+	if ((arg != "--key" && arg != "--fuzz") || i+3 >= argc) {
+		return false;
+	}
+	pxHSV hsv = linkHSV(stod(argv[i+1],nullptr),stod(argv[i+2],nullptr),stod(argv[i+3],nullptr));
+	if (arg == "--key") {
+		keyed = true;
+		keyTarget = hsv;
+	}
+	else {
+		keyFuzz = hsv;
+	}
+	i += 3;
+	return true;
+}
+
+/* A onto B into B at the --at spot with the -m mode, keying A first if asked to */
+void composeOrKey(const ImageRGBA& A, ImageRGBA& B) {
+	if (keyed) {
+		keyAndCompose(A, B, keyTarget, keyFuzz.hue, keyFuzz.saturation, keyFuzz.value, placeX, placeY, blendMode);
+	}
+	else {
+		compose(A, B, placeX, placeY, blendMode);
+	}
+}
+
+/* headless mode: put every foreground over (a copy of) one background
+ * and write it out, no window at all */
+int batchMain(int argc, char* argv[]) {
+	int jobs = 0;
+	string pattern;
+	vector<string> args;
+	for (int i=1; i<argc; i++) {
+		string arg = string(argv[i]);
+		if (isBatchFlag(arg) || readComposeFlag(argc, argv, i)) {
+			continue;
+		}
+		else if (arg == "-j" && i+1 < argc) {
+			jobs = stoi(argv[++i],nullptr);
+		}
+		else if (arg == "-o" && i+1 < argc) {
+			pattern = string(argv[++i]);
+		}
+		else {
+			args.push_back(arg);
+		}
+	}
+	if (args.size() < 2 || pattern.empty()) {
+		cerr << "usage: compose --batch (-j jobs) (-m mode) (--at x y) (--key h s v (--fuzz h s v)) [background] -o [pattern] [foregrounds...]" << endl;
+		return 1;
+	}
+	//decode the background once, every job gets its own copy to draw on
+	ImageRGBA background = readImage(args[0]);
+	vector<string> inputs = expandInputs(vector<string>(args.begin()+1, args.end()));
+	int failed = runBatch(inputs, pattern, jobs, [&](ImageRGBA image) {
+		ImageRGBA result = cloneImage(background);
+		composeOrKey(image, result);
+		return result;
+	});
+	discardImage(background);
+	return (failed > 0)? 1 : 0;
 }
 
 /* main control method that sets up the GL environment
 	and handles command line arguments */
 int main(int argc, char* argv[]){
+	for (int i=1; i<argc; i++) {
+		if (isBatchFlag(string(argv[i]))) {
+			return batchMain(argc, argv);
+		}
+		if (isRawCacheCommand(string(argv[i]))) {
+			return rawCacheMain(argc, argv);
+		}
+	}
+
+	//pull out mode, placement & key flags, everything else is read in order
+	vector<string> args;
+	for (int i=1; i<argc; i++) {
+		if (!readComposeFlag(argc, argv, i)) {
+			args.push_back(string(argv[i]));
+		}
+	}
+
 	//read arguments as filenames and attempt to read requested input files
-	if (argc >= 3) {
-		string Astr = string(argv[1]);
-		string Bstr = string(argv[2]);
+	if (args.size() >= 2) {
+		string Astr = args[0];
+		string Bstr = args[1];
 
 		//do the things
 		imageCache.push_back(readImage(Astr));
 		imageCache.push_back(readImage(Bstr));
-		compose(imageCache[0],imageCache[1]);
+		composeOrKey(imageCache[0],imageCache[1]);
 
 		//output if given 3rd filename (no default extension appending, sorry)
-		if (argc >= 4) {
-			string outstr = string(argv[3]);
+		if (args.size() >= 3) {
+			string outstr = args[2];
 			writeImage(outstr, imageCache[1]);
 		}
 	}
 	else {
-		cerr << "usage: compose [foreground].png [background] (output)" << endl;
+		cerr << "usage: compose (-m mode) (--at x y) (--key h s v (--fuzz h s v)) [foreground].png [background] (output)" << endl;
+		cerr << "       compose --batch (-j jobs) (-m mode) (--at x y) (--key h s v (--fuzz h s v)) [background] -o [pattern] [foregrounds...]" << endl;
+		cerr << "       compose --rawcache-fill [inputs...] | --rawcache-clear" << endl;
 		exit(1);
 	}
 
@@ -139,15 +231,17 @@ int main(int argc, char* argv[]){
 	glutInitWindowSize(DEFAULT_WIDTH, DEFAULT_HEIGHT);
 	glutCreateWindow("compose Result");
 
-	//if there is an image already loaded, set the resolution to fit it
+	//if there is an image already loaded, set the resolution to fit it & show it
 	refitWindow();
+	if (imageCache.size() > 0) {
+		displayImage(imageCache[cacheIndex]);
+	}
 	
 	// set up the callback routines to be called when glutMainLoop() detects
 	// an event
 	glutDisplayFunc(draw);	  // display callback
 	glutKeyboardFunc(handleKey);	  // keyboard callback
 	glutReshapeFunc(handleReshape); // window resize callback
-	glutTimerFunc(0, timer, 0); //timer func to force redraws
 
 	// Routine that loops forever looking for events. It calls the registered
 	// callback routine to handle each event that is detected
@@ -1,17 +1,32 @@
 //	convolve: OpenGL & OIIO program to apply convolution filters to an image multiple times
 //
-//	Usage: convolve [filter].filt [input].png (output)
+//	Usage: convolve (-t threads) (-m mode) (-e edge) (--repeat k) (--history mb) [filter].filt [input].png (output)
+//	       convolve --batch (-j jobs) (-t threads) (-m mode) (-e edge) (--repeat k) [filter].filt -o [pattern] [inputs...]
+//	       convolve --rawcache-fill [inputs...] | --rawcache-clear
+//	--repeat applies the filter k times over in a single pass (the kernel is convolved with itself first)
+//	--history sets how much memory undo/redo may keep (MB)
+//	big images show a shrunk preview at once while the full size filter runs in the background
 //	A .filt file is plaintext full of any numerical values
 //	that specifies its size and weights.
 //	See README.md for more details
 //
 //	CPSC 4040 | Owen Book | October 2022
 #include "gloiioFuncs.h"
+#include "gloiioDisplay.h"
+#include "gloiioPool.h"
+#include "gloiioBatch.h"
+#include "gloiioRaw.h"
+#include "gloiioHistory.h"
+#include "gloiioPyramid.h"
 #include <OpenImageIO/imageio.h>
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <cmath>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <cstring>
 
 #ifdef __APPLE__
 	#pragma clang diagnostic ignored "-Wdeprecated-declarations"
@@ -26,15 +41,55 @@ OIIO_NAMESPACE_USING;
 //default window dimensions
 #define DEFAULT_WIDTH 600	
 #define DEFAULT_HEIGHT 600
+//C shows the filter on a copy shrunk to about this many pixels right away...
+#define PREVIEW_PIXELS (512*512)
+//...while a worker thread does the real thing this many rows at a time (at least)
+#define JOB_BAND_ROWS 32
+//how often (ms) finished rows get copied into the shown image while that runs
+#define JOB_POLL_MS 16
 //output filename if provided
 static string outstr;
 //memory of loaded files/data
 static vector<ImageRGBA> imageCache;
 static vector<RawFilter> filtCache;
+//undo/redo for the working image (imageCache[1])
+static ImageHistory history;
+static size_t historyBudget = (size_t)HISTORY_BUDGET_MB*1024*1024;
+//what to read for filter taps outside the image
+static EdgeMode edgeMode = EDGE_CENTER;
+//how many times C applies the filter (--repeat), and how many the composed
+//kernel at the end of filtCache (if any) is for
+static int repeatCount = 1;
+static int composedTimes = 1;
 //current index in vector to draw/use/modify
 static int imageIndex = 0;
 static int filtIndex = 0;
 
+//a full size convolve running in the background. the worker reads the working
+//image (which nothing else changes until it's done) and writes result, whose
+//rows 0~rowsDone are finished and belong to the main thread from then on
+typedef struct convolve_job_t {
+	const ImageRGBA* source; //the working image, what the filter reads
+	ImageRGBA result;
+	ImageRGBA preview; //shrunk & filtered, the worker's until previewReady
+	RawFilter filt; //own copy, the cached one can change under it
+	EdgeMode edge;
+	int level; //pyramid level the preview is
+	atomic<bool> canceled{false};
+	atomic<bool> previewReady{false};
+	atomic<int> rowsDone{0};
+	HistoryState version; //result as a history version, the worker's until done
+	atomic<bool> done{false}; //every row finished & version made
+	thread worker;
+	~convolve_job_t() { discardRawFilter(filt); }
+} ConvolveJob;
+static unique_ptr<ConvolveJob> job; //the one running, null if none
+static ImagePyramid previewPyramid; //what the display shows while it runs
+static ImagePyramid resultPyramid; //shrinks finished rows down to the preview's size
+static bool previewShown = false;
+static int previewRows = 0; //preview rows already redone from finished rows
+static int jobId = 0; //so a stale poll timer can tell it's stale
+
 /** CONTROL FUNCTIONS **/
 /* removes an image from the imageCache */
 int removeImage(int index) {
@@ -60,6 +115,18 @@ int removeFilt(int index) {
 	return filtCache.size();
 }
 
+/* says which version the working image is at now */
+void printVersion() {
+	cout << "version " << history.current+1 << " of " << history.states.size()
+		<< " (" << history.bytes/(1024.0*1024.0) << " MB of history)" << endl;
+}
+
+/* saves the working image after an edit so it can be undone */
+void saveVersion() {
+	commitHistory(history, imageCache[imageIndex]);
+	printVersion();
+}
+
 /** OPENGL FUNCTIONS **/
 /* main display callback: displays the image of current index from imageCache. 
 if no images are loaded, only draws a black background */
@@ -67,19 +134,8 @@ void draw(){
 	//clear and make black background
 	glClearColor(0,0,0,1);
 	glClear(GL_COLOR_BUFFER_BIT);
-	if (imageCache.size() > 0) {
-		//display alphamasked image properly via blending
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glEnable(GL_BLEND);
-		//get image spec & current window size
-		ImageSpec* spec = &imageCache[imageIndex].spec;
-		glPixelZoom(1.0,1.0);
-		glPixelStorei(GL_UNPACK_ALIGNMENT, 1); //Parrot Fixer 2000
-		glRasterPos2i(0,0); //draw from bottom left
-		//draw image
-		glDrawPixels(spec->width,spec->height,GL_RGBA,GL_UNSIGNED_BYTE,&imageCache[imageIndex].pixels[0]);
-		glDisable(GL_BLEND);
-	}
+	//the image, uploading whatever changed since the last draw (see gloiioDisplay.h)
+	displayDraw();
 	//flush to viewport
 	glFlush();
 }
@@ -92,6 +148,175 @@ void refitWindow() {
 	}
 }
 
+/* the filter to apply times times over in one pass: the kernel composed with itself
+ * (kept in filtCache until a different count is asked for) */
+RawFilter repeatedFilter(int times) {
+	if (times <= 1) {
+		return filtCache[filtIndex];
+	}
+	if (times != composedTimes) {
+		if (composedTimes > 1) {
+			discardRawFilter(filtCache.back());
+			filtCache.pop_back();
+		}
+		filtCache.push_back(composeFilter(filtCache[filtIndex], times));
+		composedTimes = times;
+		cout << "composed " << times << " passes into one " << filtCache.back().size << "x" << filtCache.back().size << " kernel" << endl;
+	}
+	return filtCache.back();
+}
+
+/** BACKGROUND CONVOLVE **/
+/*	shows the preview once the worker has it, then refines it as full size rows
+ *	finish: those get shrunk down through the result's own pyramid into the
+ *	preview, so a poll costs about the rows that finished since the last one */
+void showFinishedRows() {
+	if (!previewShown) {
+		if (!job->previewReady.load()) { return; }
+		previewPyramid = makePyramid(job->preview);
+		displayPyramid(previewPyramid);
+		displayView((double)(1 << job->level), 0.0, 0.0);
+		previewShown = true;
+	}
+	int done = job->rowsDone.load();
+	//preview rows with every full size row under them finished
+	int last = (done >= job->result.spec.height)? job->preview.spec.height : done >> job->level;
+	if (last <= previewRows) { return; }
+	pyramidRefresh(resultPyramid, job->level, previewRows, last);
+	const ImageRGBA& shrunk = pyramidLevel(resultPyramid, job->level);
+	int pwidth = shrunk.spec.width;
+	memcpy(&job->preview.pixels[contigIndex(previewRows,0,pwidth)], &shrunk.pixels[contigIndex(previewRows,0,pwidth)],
+		(size_t)(last-previewRows)*pwidth*sizeof(pxRGBA));
+	displayDirtyRows(previewRows, last);
+	previewRows = last;
+}
+
+/* lets go of the job (its worker has to be done) & goes back to showing the working image */
+void dropJob() {
+	if (job->worker.joinable()) {
+		job->worker.join();
+	}
+	if (previewShown) {
+		displayImage(imageCache[imageIndex]);
+	}
+	job.reset();
+	previewPyramid = ImagePyramid();
+	resultPyramid = ImagePyramid();
+}
+
+/*	the job's done: its result becomes the working image (swapped in, not copied)
+ *	and the version the worker made of it goes in the history, so nothing here
+ *	goes over the whole image */
+void finishJob() {
+	if (job->worker.joinable()) {
+		job->worker.join();
+	}
+	imageCache[imageIndex] = move(job->result);
+	addHistoryState(history, move(job->version));
+	previewShown = true; //the working image moved, show it again either way
+	dropJob();
+	printVersion();
+}
+
+/* timer callback while a job runs: shows what's finished, wraps up once it all is */
+void pollJob(int id) {
+	if (!job || id != jobId) { return; } //canceled or finished since
+	showFinishedRows();
+	if (job->done.load()) {
+		finishJob();
+		return;
+	}
+	glutTimerFunc(JOB_POLL_MS, pollJob, id);
+}
+
+/*	stops the running job (if any). the working image was never touched, so there's
+ *	nothing to put back, but the worker reads it: this waits for it to finish the
+ *	band it's on and quit, so the image is safe to change once this returns */
+void cancelJob() {
+	if (!job) { return; }
+	job->canceled = true;
+	dropJob();
+	cout << "canceled" << endl;
+}
+
+/* blocks until the running job (if any) is done, e.g. before writing the image out */
+void waitForJob() {
+	if (!job) { return; }
+	cout << "finishing convolve..." << endl;
+	job->worker.join();
+	finishJob();
+}
+
+/*	the worker's side of a job: the preview from a pyramid level of the working image
+ *	with the filter shrunk the same amount, then the full size image from the bottom
+ *	up a band at a time, then the history version of it. checks for a cancel
+ *	between every band */
+void runJob(ConvolveJob* j) {
+	const ImageRGBA& source = *j->source;
+	int iheight = source.spec.height;
+	{
+		ImagePyramid pyr = makePyramid(source);
+		int pheight = pyramidLevel(pyr, j->level).spec.height;
+		for (int y=0; y<pheight && !j->canceled.load(); y+=JOB_BAND_ROWS) {
+			pyramidRefresh(pyr, j->level, y, y+JOB_BAND_ROWS);
+		}
+		if (j->canceled.load()) { return; }
+		j->preview = cloneImage(pyramidLevel(pyr, j->level));
+	}
+	RawFilter small = shrinkFilter(j->filt, 1 << j->level);
+	convolve(small, j->preview, j->edge);
+	discardRawFilter(small);
+	j->previewReady.store(true);
+
+	int band = (j->filt.size > JOB_BAND_ROWS)? j->filt.size : JOB_BAND_ROWS; //FFT & box bands redo a window's worth of rows
+	for (int y=0; y<iheight && !j->canceled.load(); y+=band) {
+		int y1 = (y+band < iheight)? y+band : iheight;
+		convolveRows(j->filt, source, j->result, y, y1, j->edge);
+		j->rowsDone.store(y1);
+	}
+	if (j->canceled.load()) { return; }
+	//the history version too (comparing & copying every tile), the history
+	//can't change until the main thread takes this
+	j->version = makeHistoryState(history, j->result);
+	j->done.store(true);
+}
+
+/*	applies filt to the working image without blocking the window: a worker thread
+ *	runs the filter (shrunk to match) on a small copy first and that's shown blown
+ *	back up, then it does the full size image into a new one and the poll timer
+ *	refines the preview as rows finish, swapping the result in at the end. nothing
+ *	here touches the whole image, so the key press returns right away. images
+ *	small enough to not need a preview are just done on the spot.
+ *	starting a new one cancels the one before instead of stacking on top of it */
+void startJob(RawFilter filt) {
+	cancelJob();
+	ImageRGBA& working = imageCache[imageIndex];
+	int iwidth = working.spec.width;
+	int iheight = working.spec.height;
+	int level = 0;
+	while ((double)(iwidth >> level)*(iheight >> level) > PREVIEW_PIXELS) {
+		level++;
+	}
+	if (level == 0) {
+		convolve(filt, working, edgeMode);
+		saveVersion();
+		displayDirty();
+		return;
+	}
+
+	job.reset(new ConvolveJob);
+	job->source = &working;
+	job->result = ImageRGBA(working.spec);
+	job->filt = composeFilter(filt, 1);
+	job->edge = edgeMode;
+	job->level = level;
+	resultPyramid = makePyramid(job->result);
+	previewShown = false;
+	previewRows = 0;
+	job->worker = thread(runJob, job.get());
+	glutTimerFunc(JOB_POLL_MS, pollJob, ++jobId);
+}
+
 /*
    Keyboard Callback Routine
    This routine is called every time a key is pressed on the keyboard
@@ -109,17 +334,62 @@ void handleKey(unsigned char key, int x, int y){
 			return;*/
 		case 'c':
 		case 'C':
-			convolve(filtCache[filtIndex], imageCache[imageIndex]);
+			startJob(repeatedFilter(repeatCount));
 			//cout << "applied to image " << imageIndex+1 << " of " << imageCache.size() << endl;
 			return;
+		case 'k':
+		case 'K': {
+			int times = 0;
+			cout << "apply filter how many times? ";
+			cin >> times;
+			if (!cin) {
+				cin.clear();
+				cin.ignore(1024, '\n');
+				return;
+			}
+			if (times < 1) {
+				cerr << "the filter has to be applied at least once" << endl;
+				return;
+			}
+			startJob(repeatedFilter(times));
+			return;
+		}
 		case 'r':
 		case 'R':
-			if (imageCache.size() > 1) {
-				removeImage(imageIndex);
-				imageCache.push_back(cloneImage(imageCache[0]));
-				imageIndex = imageCache.size()-1;
+			cancelJob();
+			if (imageCache.size() > 1 && imageIndex > 0) {
+				//same size as the original, so just copy it back over the working image
+				copyPixels(imageCache[0], imageCache[imageIndex]);
+				cout << "reverted to original image" << endl;
+				saveVersion(); //so the revert can be undone too
+				displayDirty();
+			}
+			return;
+		case 'u':
+		case 'U':
+		case 26: // ctrl-z
+			if (job) {
+				cancelJob(); //the edit in progress is the one to undo
+			}
+			else if (undoHistory(history, imageCache[imageIndex])) {
+				cout << "undo: version " << history.current+1 << " of " << history.states.size() << endl;
+				displayDirty();
+			}
+			else {
+				cout << "nothing to undo" << endl;
+			}
+			return;
+		case 'y':
+		case 'Y':
+		case 25: // ctrl-y
+			cancelJob();
+			if (redoHistory(history, imageCache[imageIndex])) {
+				cout << "redo: version " << history.current+1 << " of " << history.states.size() << endl;
+				displayDirty();
+			}
+			else {
+				cout << "nothing to redo" << endl;
 			}
-			cout << "reverted to original image" << endl;
 			return;
 		case 'w':
 		case 'W':
@@ -127,11 +397,13 @@ void handleKey(unsigned char key, int x, int y){
 				cout << "enter output filename: ";
 				cin >> outstr;
 			}
+			waitForJob(); //write the real thing, not the preview
 			writeImage(outstr, imageCache[imageIndex]);
 			return;
 		case 'q':		// q - quit
 		case 'Q':
 		case 27:		// esc - quit
+			cancelJob();
 			exit(0);
 		default:		// not a valid key -- just ignore it
 			return;
@@ -153,36 +425,95 @@ void handleReshape(int w, int h){
   gluOrtho2D(0, w, 0, h);
 }
 
-/* timer function to make the OS always update the window 
-	(fixes hang on launch...)*/
-void timer( int value )
-{
-    glutPostRedisplay();
-    glutTimerFunc( 33, timer, 0 );
-}
-
 /* main control method that sets up the GL environment
 	and handles command line arguments */
 int main(int argc, char* argv[]){
+	//pull out option flags, everything else is read as filenames in order
+	vector<string> args;
+	bool batch = false;
+	int jobs = 0;
+	string pattern;
+	for (int i=1; i<argc; i++) {
+		string arg = string(argv[i]);
+		if (isRawCacheCommand(arg)) {
+			return rawCacheMain(argc, argv);
+		}
+		else if (isBatchFlag(arg)) {
+			batch = true;
+		}
+		else if (arg == "-j" && i+1 < argc) {
+			jobs = stoi(argv[++i],nullptr);
+		}
+		else if (arg == "-o" && i+1 < argc) {
+			pattern = string(argv[++i]);
+		}
+		else if ((arg == "-t" || arg == "--threads") && i+1 < argc) {
+			setThreadCount(stoi(argv[++i],nullptr));
+		}
+		else if ((arg == "-m" || arg == "--mode") && i+1 < argc) {
+			setConvolveMode(convolveModeFromName(argv[++i]));
+		}
+		else if ((arg == "-e" || arg == "--edge") && i+1 < argc) {
+			edgeMode = edgeModeFromName(argv[++i]);
+		}
+		else if (arg == "--repeat" && i+1 < argc) {
+			repeatCount = stoi(argv[++i],nullptr);
+			if (repeatCount < 1) {
+				cerr << "--repeat has to be at least 1" << endl;
+				exit(1);
+			}
+		}
+		else if (arg == "--history" && i+1 < argc) {
+			historyBudget = (size_t)stoi(argv[++i],nullptr)*1024*1024;
+		}
+		else {
+			args.push_back(arg);
+		}
+	}
+
+	//headless: filter every input and write it out, no window at all
+	if (batch) {
+		if (args.size() < 2 || pattern.empty()) {
+			cerr << "usage: convolve --batch (-j jobs) (--repeat k) [filter].filt -o [pattern] [inputs...]" << endl;
+			exit(1);
+		}
+		RawFilter filt = readFilter(args[0]);
+		if (repeatCount > 1) {
+			RawFilter once = filt;
+			filt = composeFilter(once, repeatCount);
+			discardRawFilter(once);
+		}
+		vector<string> inputs = expandInputs(vector<string>(args.begin()+1, args.end()));
+		int failed = runBatch(inputs, pattern, jobs, [&](ImageRGBA image) {
+			convolve(filt, image, edgeMode);
+			return image;
+		});
+		discardRawFilter(filt);
+		return (failed > 0)? 1 : 0;
+	}
+
 	//read arguments as filenames and attempt to read requested input files
-	if (argc >= 3) {
-		string filtstr = string(argv[1]);
-		string instr = string(argv[2]);
+	if (args.size() >= 2) {
+		string filtstr = args[0];
+		string instr = args[1];
 
 		//read from files
 		filtCache.push_back(readFilter(filtstr));
 		imageCache.push_back(readImage(instr));
 
 		//output if given 3rd filename (no default extension appending, sorry)
-		if (argc >= 4) {
-			outstr = string(argv[3]);
+		if (args.size() >= 3) {
+			outstr = args[2];
 		}
 
 		imageCache.push_back(cloneImage(imageCache[0])); //create copy for working on
 		imageIndex = imageCache.size()-1;
+		history = startHistory(imageCache[imageIndex], historyBudget);
 	}
 	else {
-		cerr << "usage: convolve [filter].filt [input].png (output)" << endl;
+		cerr << "usage: convolve (-t threads) (-m mode) (-e edge) (--repeat k) (--history mb) [filter].filt [input].png (output)" << endl;
+		cerr << "       convolve --batch (-j jobs) (--repeat k) [filter].filt -o [pattern] [inputs...]" << endl;
+		cerr << "       convolve --rawcache-fill [inputs...] | --rawcache-clear" << endl;
 		exit(1);
 	}
 
@@ -194,15 +525,17 @@ int main(int argc, char* argv[]){
 	glutInitWindowSize(DEFAULT_WIDTH, DEFAULT_HEIGHT);
 	glutCreateWindow("convolve");
 
-	//if there is an image already loaded, set the resolution to fit it
+	//if there is an image already loaded, set the resolution to fit it & show it
 	refitWindow();
+	if (imageCache.size() > 0) {
+		displayImage(imageCache[imageIndex]);
+	}
 	
 	// set up the callback routines to be called when glutMainLoop() detects
 	// an event
 	glutDisplayFunc(draw);	  // display callback
 	glutKeyboardFunc(handleKey);	  // keyboard callback
 	glutReshapeFunc(handleReshape); // window resize callback
-	glutTimerFunc(0, timer, 0); //timer func to force redraws
 
 	// Routine that loops forever looking for events. It calls the registered
 	// callback routine to handle each event that is detected
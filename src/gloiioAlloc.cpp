@@ -0,0 +1,127 @@
+#include "gloiioAlloc.h"
+#include <mutex>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cstdlib>
+#include <sys/mman.h>
+#ifdef __GLIBC__
+	#include <malloc.h>
+#endif
+
+using namespace std;
+
+/** PIXEL POOL **/
+/*	free buffers sorted by size. a session only ever deals in a few image sizes
+ *	(the original, its working copy, convolve's scratch, pipeline bands...) so
+ *	most allocations are a lookup here instead of malloc plus page faulting
+ *	fresh memory in, and most frees are a push */
+typedef struct pixel_pool_t {
+	mutex lock;
+	unordered_map<size_t, vector<void*>> freeBuffers;
+	size_t bytes = 0;
+} PixelPool;
+
+/*	the pool, made the first time it's needed and never destroyed on purpose:
+ *	images held in the programs' statics get released during exit, possibly
+ *	after a plain static pool would already be gone */
+static PixelPool& pixelPool() {
+	static PixelPool& pool = *new PixelPool;
+	return pool;
+}
+
+static bool hugePages() {
+	static bool on = [] {
+		const char* env = getenv(HUGEPAGE_ENV);
+		return env && (string(env) == "on" || string(env) == "1");
+	}();
+	return on;
+}
+
+/* alignment a buffer of this many bytes gets */
+static size_t bufferAlign(size_t bytes) {
+	return (hugePages() && bytes >= HUGEPAGE_BYTES)? HUGEPAGE_BYTES : PIXEL_ALIGN;
+}
+
+/* what a request for this many bytes really gets (the pool is keyed on it) */
+static size_t bufferSize(size_t bytes) {
+	size_t align = bufferAlign(bytes);
+	return (bytes+align-1)/align*align;
+}
+
+/*	PIXEL_ALIGN aligned buffer of at least bytes bytes (contents are garbage)
+ *	reuses a pooled buffer of the same size if there is one. with GLOIIO_HUGEPAGES
+ *	on, big ones are huge page aligned and the kernel is asked to back them with
+ *	huge pages, which saves a lot of TLB misses walking down a 4K image
+ *	THROWS bad_alloc like new does */
+void* allocPixels(size_t bytes) {
+	if (bytes == 0) { return nullptr; }
+	size_t size = bufferSize(bytes);
+	{
+		PixelPool& pool = pixelPool();
+		lock_guard<mutex> lk(pool.lock);
+		auto found = pool.freeBuffers.find(size);
+		if (found != pool.freeBuffers.end() && !found->second.empty()) {
+			void* buf = found->second.back();
+			found->second.pop_back();
+			pool.bytes -= size;
+			return buf;
+		}
+	}
+	void* buf = nullptr;
+	if (posix_memalign(&buf, bufferAlign(bytes), size) != 0) {
+		throw bad_alloc();
+	}
+#ifdef MADV_HUGEPAGE
+	if (bufferAlign(bytes) == HUGEPAGE_BYTES) {
+		madvise(buf, size, MADV_HUGEPAGE); //only a hint, fine if it's ignored
+	}
+#endif
+	return buf;
+}
+
+/*	gives back a buffer from allocPixels (bytes has to be what it was asked for)
+ *	it goes in the pool for the next buffer that size unless the pool is full */
+void releasePixels(void* buf, size_t bytes) {
+	if (!buf) { return; }
+	size_t size = bufferSize(bytes);
+	{
+		PixelPool& pool = pixelPool();
+		lock_guard<mutex> lk(pool.lock);
+		if (pool.bytes+size <= PIXEL_POOL_BYTES) {
+			pool.freeBuffers[size].push_back(buf);
+			pool.bytes += size;
+			return;
+		}
+	}
+	free(buf);
+}
+
+/*	gives back a buffer from allocPixels for good, skipping the pool, for memory
+ *	somebody is keeping count of (like imgview's cache budget). glibc hangs on to
+ *	freed heap pages otherwise, so it's asked to hand them back to the system too */
+void freePixels(void* buf) {
+	if (!buf) { return; }
+	free(buf);
+#ifdef __GLIBC__
+	malloc_trim(0);
+#endif
+}
+
+/** MAPPED FILES **/
+/*	maps the first bytes bytes of the open file fd copy-on-write: reading pages
+ *	them in from the file as they're touched, writing only changes this process'
+ *	copy of the page (the file never changes). the fd can be closed right after
+ *	returns nullptr if the mapping failed */
+void* mapPixelFile(int fd, size_t bytes) {
+	void* base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	return (base == MAP_FAILED)? nullptr : base;
+}
+
+/* undoes mapPixelFile (any changes made through it are gone) */
+void unmapPixelFile(void* base, size_t bytes) {
+	if (base) {
+		munmap(base, bytes);
+	}
+}
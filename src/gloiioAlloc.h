@@ -0,0 +1,20 @@
+#ifndef GLOIIO_OB_ALLOC_H
+#define GLOIIO_OB_ALLOC_H
+#include <cstddef>
+
+//every pixel buffer starts on a cache line (also enough for any AVX load)
+#define PIXEL_ALIGN 64
+//environment variable that backs big buffers with huge pages (on|off, off by default)
+#define HUGEPAGE_ENV "GLOIIO_HUGEPAGES"
+//buffers at least this big get huge pages when they're on (and are rounded up to it)
+#define HUGEPAGE_BYTES ((size_t)2*1024*1024)
+//most free memory the pool keeps around for reuse, anything past it really gets freed
+#define PIXEL_POOL_BYTES ((size_t)256*1024*1024)
+
+void* allocPixels(size_t);
+void releasePixels(void*, size_t);
+void freePixels(void*);
+void* mapPixelFile(int, size_t);
+void unmapPixelFile(void*, size_t);
+
+#endif
@@ -0,0 +1,193 @@
+#include "gloiioBatch.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+#include <glob.h>
+
+/** ARGUMENTS **/
+/* true for the flags that put a program in headless batch mode */
+bool isBatchFlag(string arg) {
+	return arg == "--batch" || arg == "--headless";
+}
+
+/*	expands any argument with glob characters (*, ?, [) into the matching files
+ *	(sorted), for when the pattern was quoted past the shell. others pass through */
+vector<string> expandInputs(vector<string> args) {
+	vector<string> files;
+	for (string& arg : args) {
+		if (arg.find_first_of("*?[") == string::npos) {
+			files.push_back(arg);
+			continue;
+		}
+		glob_t found;
+		if (glob(arg.c_str(), 0, nullptr, &found) == 0) {
+			for (size_t i=0; i<found.gl_pathc; i++) {
+				files.push_back(found.gl_pathv[i]);
+			}
+		}
+		else {
+			cerr << "no files match " << arg << endl;
+		}
+		globfree(&found);
+	}
+	return files;
+}
+
+/*	builds the output filename for the index'th input from the -o pattern
+ *	%s becomes the input's name without folder or extension, %d the index,
+ *	a pattern ending in / is a folder that gets the input's own filename.
+ *	defaultExt is appended if the result has no extension */
+string outputName(string pattern, string input, int index, string defaultExt) {
+	size_t slash = input.find_last_of('/');
+	string base = (slash == string::npos)? input : input.substr(slash+1);
+	size_t dot = base.find_last_of('.');
+	string stem = (dot == string::npos)? base : base.substr(0, dot);
+
+	string out;
+	if (!pattern.empty() && pattern.back() == '/') {
+		out = pattern + base;
+	}
+	else {
+		for (size_t i=0; i<pattern.length(); i++) {
+			if (pattern[i] == '%' && i+1 < pattern.length()) {
+				char c = pattern[++i];
+				if (c == 's') { out += stem; }
+				else if (c == 'd') { out += to_string(index); }
+				else { out += c; } //%% and anything else
+			}
+			else {
+				out += pattern[i];
+			}
+		}
+	}
+	size_t outSlash = out.find_last_of('/');
+	size_t outDot = out.find_last_of('.');
+	if (!defaultExt.empty() && (outDot == string::npos || (outSlash != string::npos && outDot < outSlash))) {
+		out += defaultExt;
+	}
+	return out;
+}
+
+/** JOB QUEUE **/
+/*	fixed size queue between the reader and the workers
+ *	push blocks while it's full, pop blocks while it's empty until close() */
+template <typename T>
+class BoundedQueue {
+public:
+	BoundedQueue(size_t cap) : capacity(cap) {}
+
+	void push(T item) {
+		unique_lock<mutex> lk(lock);
+		notFull.wait(lk, [&]{ return items.size() < capacity; });
+		items.push_back(item);
+		notEmpty.notify_one();
+	}
+
+	bool pop(T& item) {
+		unique_lock<mutex> lk(lock);
+		notEmpty.wait(lk, [&]{ return closed || !items.empty(); });
+		if (items.empty()) { return false; }
+		item = items.front();
+		items.pop_front();
+		notFull.notify_one();
+		return true;
+	}
+
+	void close() {
+		lock_guard<mutex> lk(lock);
+		closed = true;
+		notEmpty.notify_all();
+	}
+
+private:
+	size_t capacity;
+	bool closed = false;
+	deque<T> items;
+	mutex lock;
+	condition_variable notEmpty, notFull;
+};
+
+/** BATCH RUNNER **/
+typedef struct batch_job_t {
+	int index;
+	string input;
+} BatchJob;
+
+/*	reads every input, runs op on it and writes what op returns to
+ *	outputName(pattern,...), with jobs files in flight at once.
+ *	op is handed the image and returns the one to write (that one or a new one).
+ *	prints a line per file and a throughput summary, returns how many failed */
+int runBatch(vector<string> inputs, string pattern, int jobs, function<ImageRGBA(ImageRGBA)> op, string defaultExt) {
+	typedef chrono::steady_clock clk;
+	if (inputs.empty()) {
+		cerr << "no input files!" << endl;
+		return 1;
+	}
+	if (inputs.size() > 1 && pattern.find('%') == string::npos && pattern.back() != '/') {
+		cerr << "output " << pattern << " would be overwritten by every input, use %s, %d or a folder/" << endl;
+		return (int)inputs.size();
+	}
+	if (jobs <= 0) {
+		jobs = thread::hardware_concurrency();
+		if (jobs <= 0) { jobs = 1; }
+	}
+	if (jobs > (int)inputs.size()) { jobs = inputs.size(); }
+
+	BoundedQueue<BatchJob> queue(BATCH_QUEUE_DEPTH);
+	mutex reportLock;
+	int failed = 0;
+	double totalMP = 0.0;
+	clk::time_point start = clk::now();
+
+	auto worker = [&]{
+		BatchJob job;
+		while (queue.pop(job)) {
+			string out = outputName(pattern, job.input, job.index, defaultExt);
+			ostringstream line;
+			clk::time_point t0 = clk::now();
+			bool ok = false;
+			double mp = 0.0;
+			try {
+				ImageRGBA in = readImage(job.input);
+				mp = (double)in.spec.width*in.spec.height/1e6;
+				ImageRGBA res = op(std::move(in));
+				ok = writeImage(out, res, true); //the line below says it was written
+			}
+			catch (exception &e) {} //(error message is inside readImage already)
+			double ms = chrono::duration<double,milli>(clk::now()-t0).count();
+			line << fixed << setprecision(1);
+			if (ok) {
+				line << job.input << " -> " << out << ": " << mp << " MP in " << ms << " ms ("
+					<< setprecision(2) << mp/(ms/1000.0) << " MP/s)";
+			}
+			else {
+				line << job.input << ": FAILED";
+			}
+			lock_guard<mutex> lk(reportLock);
+			cout << line.str() << endl;
+			if (ok) { totalMP += mp; }
+			else { failed++; }
+		}
+	};
+	vector<thread> workers;
+	for (int i=0; i<jobs; i++) {
+		workers.emplace_back(worker);
+	}
+	for (size_t i=0; i<inputs.size(); i++) {
+		BatchJob job = {(int)i, inputs[i]};
+		queue.push(job);
+	}
+	queue.close();
+	for (thread& t : workers) { t.join(); }
+
+	double secs = chrono::duration<double>(clk::now()-start).count();
+	int done = inputs.size()-failed;
+	cout << fixed << setprecision(2);
+	cout << done << "/" << inputs.size() << " files, " << totalMP << " MP in " << secs << " s ("
+		<< totalMP/secs << " MP/s, " << done/secs << " files/s, " << jobs << " jobs)" << endl;
+	return failed;
+}
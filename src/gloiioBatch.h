@@ -0,0 +1,15 @@
+#ifndef GLOIIO_OB_BATCH_H
+#define GLOIIO_OB_BATCH_H
+#include "gloiioFuncs.h"
+#include <vector>
+#include <functional>
+
+//inputs waiting for a free worker before the feeder blocks
+#define BATCH_QUEUE_DEPTH 4
+
+bool isBatchFlag(string);
+vector<string> expandInputs(vector<string>);
+string outputName(string, string, int, string defaultExt = "");
+int runBatch(vector<string>, string, int, function<ImageRGBA(ImageRGBA)>, string defaultExt = "");
+
+#endif
@@ -0,0 +1,118 @@
+//the lane helpers are always inlined, so vectors never actually get passed across a call
+#pragma GCC diagnostic ignored "-Wpsabi"
+#include "gloiioBlend.h"
+#include "gloiioSIMD.h"
+#include <cstdint>
+#include <cstring>
+
+/** ROW ENGINE **/
+//4 pixels widened to 16 bit lanes, and the same pixels as bytes (GCC vector extensions,
+//so the compiler picks the instructions for whatever target the loop is built for)
+typedef uint16_t BlendLanes __attribute__((vector_size(32)));
+typedef uint8_t BlendBytes __attribute__((vector_size(16)));
+typedef uint64_t BlendQuads __attribute__((vector_size(32))); //one pixel per element
+#define BLEND_PIXELS 4
+
+/* each pixel's alpha copied into all 4 of its lanes (64 bit shifts, so plain SSE2 does it) */
+static BLEND_INLINE BlendLanes alphaLanes(const BlendLanes& px) {
+	BlendQuads a = (BlendQuads)px >> 48;
+	a |= a << 16;
+	a |= a << 32;
+	return (BlendLanes)a;
+}
+
+/* blends 4 pixels of fg into bg with Mode */
+template<class Mode> static BLEND_INLINE void blendFour(const pxRGBA* fg, pxRGBA* bg) {
+	const BlendLanes isAlpha = {0,0,0,0xFFFF, 0,0,0,0xFFFF, 0,0,0,0xFFFF, 0,0,0,0xFFFF};
+	BlendBytes fbytes, bbytes;
+	memcpy(&fbytes, fg, sizeof(fbytes));
+	memcpy(&bbytes, bg, sizeof(bbytes));
+	BlendLanes f = __builtin_convertvector(fbytes, BlendLanes);
+	BlendLanes b = __builtin_convertvector(bbytes, BlendLanes);
+	BlendLanes fa = alphaLanes(f);
+	BlendLanes ba = alphaLanes(b);
+	//premultiply, alpha lanes are multiplied by 255 i.e. left alone
+	f = mul255(f, (isAlpha & 255) | (~isAlpha & fa));
+	b = mul255(b, (isAlpha & 255) | (~isAlpha & ba));
+	BlendLanes out = Mode::apply(f, fa, b, ba, isAlpha);
+	out = min255(out, BlendLanes{} + 255);
+	BlendBytes obytes = __builtin_convertvector(out, BlendBytes);
+	memcpy(bg, &obytes, sizeof(obytes));
+}
+
+/* blends one pixel of fg into bg with Mode, a channel at a time */
+template<class Mode> static BLEND_INLINE void blendOne(const pxRGBA* fg, pxRGBA* bg) {
+	const unsigned char* fch = (const unsigned char*)fg;
+	unsigned char* bch = (unsigned char*)bg;
+	int fa = fg->alpha;
+	int ba = bg->alpha;
+	unsigned char out[4];
+	for (int c=0; c<4; c++) {
+		int isAlpha = (c == 3)? -1 : 0;
+		int f = (c == 3)? fa : mul255((int)fch[c], fa);
+		int b = (c == 3)? ba : mul255((int)bch[c], ba);
+		out[c] = min255(Mode::apply(f, fa, b, ba, isAlpha), 255);
+	}
+	memcpy(bch, out, 4);
+}
+
+/* the same loop, built for whatever target it's compiled in */
+#define BLEND_SPAN_BODY \
+	int i = 0; \
+	for (; i+BLEND_PIXELS<=count; i+=BLEND_PIXELS) { \
+		blendFour<Mode>(&fg[i], &bg[i]); \
+	} \
+	for (; i<count; i++) { \
+		blendOne<Mode>(&fg[i], &bg[i]); \
+	}
+
+template<class Mode> static void blendSpanDefault(const pxRGBA* fg, pxRGBA* bg, int count) {
+	BLEND_SPAN_BODY
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+//x86 builds get the loop twice more, the lanes fill two SSE registers or one AVX2 register
+template<class Mode> __attribute__((target("sse4.1"))) static void blendSpanSSE41(const pxRGBA* fg, pxRGBA* bg, int count) {
+	BLEND_SPAN_BODY
+}
+template<class Mode> __attribute__((target("avx2"))) static void blendSpanAVX2(const pxRGBA* fg, pxRGBA* bg, int count) {
+	BLEND_SPAN_BODY
+}
+#endif
+
+/* one row with one mode, on the widest instruction set from simdLevel()
+ * (anything less, and other CPUs, get the vector loop built for the default target) */
+template<class Mode> static void blendSpan(const pxRGBA* fg, pxRGBA* bg, int count) {
+#if defined(__x86_64__) || defined(__i386__)
+	SimdLevel level = simdLevel();
+	if (level == SIMD_AVX2) {
+		blendSpanAVX2<Mode>(fg, bg, count);
+	}
+	else if (level == SIMD_SSE41) {
+		blendSpanSSE41<Mode>(fg, bg, count);
+	}
+	else {
+		blendSpanDefault<Mode>(fg, bg, count); //SSE2, the x86-64 baseline
+	}
+#else
+	blendSpanDefault<Mode>(fg, bg, count);
+#endif
+}
+
+/*	combines count pixels of fg into bg with mode (straight alpha in, premultiplied out
+ *	like compose always has). 8 bit integer math, over is within 1 per channel of the
+ *	original double precision version. the mode is picked once per row */
+void blendRow(BlendMode mode, const pxRGBA* fg, pxRGBA* bg, int count) {
+	switch (mode) {
+		case BLEND_IN: blendSpan<BlendIn>(fg, bg, count); break;
+		case BLEND_OUT: blendSpan<BlendOut>(fg, bg, count); break;
+		case BLEND_ATOP: blendSpan<BlendAtop>(fg, bg, count); break;
+		case BLEND_XOR: blendSpan<BlendXor>(fg, bg, count); break;
+		case BLEND_PLUS: blendSpan<BlendPlus>(fg, bg, count); break;
+		case BLEND_MULTIPLY: blendSpan<BlendMultiply>(fg, bg, count); break;
+		case BLEND_SCREEN: blendSpan<BlendScreen>(fg, bg, count); break;
+		case BLEND_ADD: blendSpan<BlendAdd>(fg, bg, count); break;
+		case BLEND_DIFFERENCE: blendSpan<BlendDifference>(fg, bg, count); break;
+		default: blendSpan<BlendOver>(fg, bg, count); break;
+	}
+}
@@ -0,0 +1,95 @@
+#ifndef GLOIIO_OB_BLEND_H
+#define GLOIIO_OB_BLEND_H
+#include "gloiioFuncs.h"
+
+//force the per pixel pieces inline (even in -O0 builds) so each mode gets its own straight loop
+#define BLEND_INLINE inline __attribute__((always_inline))
+
+/*	BLEND POLICIES
+ *	each mode is a type with one apply() that the row engine (gloiioBlend.cpp)
+ *	is instantiated with, so every mode gets its own loop with no switch inside.
+ *	apply() is written with plain operators so the same code runs on a single int
+ *	channel or on a whole vector of 16 bit lanes (4 pixels' r,g,b,a). it takes
+ *	(f, fa, b, ba, isAlpha), leaving the ones a mode doesn't need unnamed:
+ *	- f, b: foreground & background channels, premultiplied, 0~255
+ *	  (the alpha lane holds the alpha itself)
+ *	- fa, ba: foreground & background alpha, repeated in every lane of their pixel
+ *	- isAlpha: all ones in alpha lanes, 0 in color lanes
+ *	and gives the premultiplied result, which the engine clips to 0~255.
+ *	to add a mode: write its policy here, add it to BlendMode & blendModeFromName,
+ *	and give it a case in blendRow */
+
+/*	a*b/255 rounded to nearest, exact for any two 8 bit values (rounding instead
+ *	of flooring keeps the error from piling up in modes that add several products).
+ *	the sums stay under 65536, so it's fine in 16 bit lanes */
+template<class V> static BLEND_INLINE V mul255(const V& a, const V& b) {
+	V t = a*b + 128;
+	return (t + (t >> 8)) >> 8;
+}
+template<class V> static BLEND_INLINE V inv255(const V& a) {
+	return 255 - a;
+}
+template<class V> static BLEND_INLINE V min255(const V& a, const V& b) {
+	return (a < b)? a : b;
+}
+
+//Porter-Duff operators: f*(A's share) + b*(B's share), the same in color & alpha lanes
+struct BlendOver {
+	template<class V> static BLEND_INLINE V apply(const V& f, const V& fa, const V& b, const V&, const V&) {
+		return f + mul255(inv255(fa), b);
+	}
+};
+struct BlendIn {
+	template<class V> static BLEND_INLINE V apply(const V& f, const V&, const V&, const V& ba, const V&) {
+		return mul255(f, ba);
+	}
+};
+struct BlendOut {
+	template<class V> static BLEND_INLINE V apply(const V& f, const V&, const V&, const V& ba, const V&) {
+		return mul255(f, inv255(ba));
+	}
+};
+struct BlendAtop {
+	template<class V> static BLEND_INLINE V apply(const V& f, const V& fa, const V& b, const V& ba, const V&) {
+		return mul255(f, ba) + mul255(b, inv255(fa));
+	}
+};
+struct BlendXor {
+	template<class V> static BLEND_INLINE V apply(const V& f, const V& fa, const V& b, const V& ba, const V&) {
+		return mul255(f, inv255(ba)) + mul255(b, inv255(fa));
+	}
+};
+struct BlendPlus {
+	template<class V> static BLEND_INLINE V apply(const V& f, const V&, const V& b, const V&, const V&) {
+		return f + b; //clipped by the engine
+	}
+};
+
+//separable blend modes: the parts that don't overlap like xor, plus fa*ba*blend(A,B) where they do
+//(written out in premultiplied terms, the alpha lane comes out as fa+ba-fa*ba)
+struct BlendMultiply {
+	template<class V> static BLEND_INLINE V apply(const V& f, const V& fa, const V& b, const V& ba, const V&) {
+		return mul255(f, inv255(ba)) + mul255(b, inv255(fa)) + mul255(f, b);
+	}
+};
+struct BlendScreen {
+	template<class V> static BLEND_INLINE V apply(const V& f, const V&, const V& b, const V&, const V&) {
+		return f + b - mul255(f, b);
+	}
+};
+struct BlendAdd {
+	template<class V> static BLEND_INLINE V apply(const V& f, const V& fa, const V& b, const V& ba, const V&) {
+		return mul255(f, inv255(ba)) + mul255(b, inv255(fa)) + min255(mul255(fa, ba), mul255(f, ba) + mul255(b, fa));
+	}
+};
+struct BlendDifference {
+	template<class V> static BLEND_INLINE V apply(const V& f, const V& fa, const V& b, const V& ba, const V& isAlpha) {
+		V color = f + b - 2*min255(mul255(f, ba), mul255(b, fa));
+		V alpha = f + b - mul255(f, b);
+		return (isAlpha & alpha) | (~isAlpha & color);
+	}
+};
+
+void blendRow(BlendMode, const pxRGBA*, pxRGBA*, int);
+
+#endif
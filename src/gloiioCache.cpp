@@ -0,0 +1,237 @@
+#include "gloiioCache.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <cstdlib>
+
+using namespace std;
+
+/** IMAGE CACHE **/
+//one file the viewer knows about: the header is read when it's added,
+//the pixels only when somebody looks at it (or is about to)
+typedef struct cache_entry_t {
+	string path;
+	ImageSpec spec; //from the header
+	ImageRGBA image; //empty until decoded, and again after being evicted
+	unsigned long lastUsed = 0; //tick of the last cacheImage/cachePrefetch on it
+	bool loading = false; //somebody is decoding it right now
+	bool edited = false; //changed in memory, evicting it would lose that
+	bool failed = false; //couldn't be decoded, don't keep trying
+} CacheEntry;
+
+/* bytes an entry's pixels take once decoded */
+static size_t entryBytes(const CacheEntry& e) {
+	return (size_t)e.spec.width*e.spec.height*sizeof(pxRGBA);
+}
+
+/*	every image the viewer was given, decoded lazily and kept under a byte budget
+ *	by dropping the least recently viewed ones. a worker thread decodes prefetch
+ *	requests in the background so they're ready by the time they're asked for.
+ *	entries live in a deque and are never removed, so pointers to them stay good;
+ *	the pixels of the one viewed last are never evicted out from under the viewer */
+class ImageStore {
+public:
+	ImageStore() {
+		const char* env = getenv(CACHE_BUDGET_ENV);
+		budget = (size_t)((env && atoi(env) > 0)? atoi(env) : CACHE_BUDGET_MB)*1024*1024;
+		worker = thread([this]{ prefetchLoop(); });
+	}
+	~ImageStore() {
+		{
+			lock_guard<mutex> lk(lock);
+			quitting = true;
+		}
+		wantedCond.notify_all();
+		worker.join();
+	}
+
+	/* reads path's header and adds it, returns its index (-1 if it couldn't be opened) */
+	int add(string path) {
+		CacheEntry e;
+		e.path = path;
+		if (!readImageSpec(path, e.spec)) { return -1; }
+		lock_guard<mutex> lk(lock);
+		entries.push_back(std::move(e));
+		return entries.size()-1;
+	}
+
+	int count() {
+		lock_guard<mutex> lk(lock);
+		return entries.size();
+	}
+
+	string path(int i) {
+		lock_guard<mutex> lk(lock);
+		return entries[i].path;
+	}
+
+	ImageSpec spec(int i) {
+		lock_guard<mutex> lk(lock);
+		return entries[i].spec;
+	}
+
+	/* image i, decoded right here if it isn't yet (waits if the worker is on it) */
+	ImageRGBA* get(int i) {
+		unique_lock<mutex> lk(lock);
+		CacheEntry& e = entries[i];
+		current = i;
+		e.lastUsed = ++tick;
+		loadedCond.wait(lk, [&]{ return !e.loading; });
+		if (!e.image.pixels && !e.failed) {
+			load(e, lk);
+		}
+		return e.failed? nullptr : &e.image;
+	}
+
+	void edited(int i) {
+		lock_guard<mutex> lk(lock);
+		entries[i].edited = true;
+	}
+
+	/* asks the worker to decode image i soon, if it's not in memory and would fit */
+	void prefetch(int i) {
+		{
+			lock_guard<mutex> lk(lock);
+			if (i < 0 || i >= (int)entries.size()) { return; }
+			CacheEntry& e = entries[i];
+			if (e.image.pixels || e.loading || e.failed) { return; }
+			size_t shown = (current >= 0)? entryBytes(entries[current]) : 0;
+			if (entryBytes(e)+shown > budget) { return; } //would only push out what's on screen
+			e.lastUsed = ++tick; //about to be looked at, don't evict it first thing
+			wanted.push_back(i);
+			while (wanted.size() > CACHE_PREFETCH_DEPTH) { wanted.pop_front(); }
+		}
+		wantedCond.notify_one();
+	}
+
+	void resize(size_t bytes) {
+		lock_guard<mutex> lk(lock);
+		budget = bytes;
+		evict();
+	}
+
+	size_t used() {
+		lock_guard<mutex> lk(lock);
+		return bytes;
+	}
+
+private:
+	deque<CacheEntry> entries;
+	deque<int> wanted; //prefetch requests, newest last
+	int current = -1; //last one asked for with get, never evicted
+	unsigned long tick = 0;
+	size_t bytes = 0; //decoded pixels held
+	size_t budget;
+	bool quitting = false;
+	mutex lock;
+	condition_variable loadedCond; //some entry finished loading
+	condition_variable wantedCond; //new prefetch request (or quitting)
+	thread worker;
+
+	/* decodes e with the lock let go in the meantime, then makes room for it */
+	void load(CacheEntry& e, unique_lock<mutex>& lk) {
+		e.loading = true;
+		string path = e.path;
+		lk.unlock();
+		ImageRGBA image;
+		bool ok = true;
+		try {
+			image = readImage(path);
+		}
+		catch (exception& ex) { ok = false; } //(error message is inside readImage already)
+		lk.lock();
+		e.loading = false;
+		if (ok) {
+			e.image = std::move(image);
+			bytes += entryBytes(e);
+			evict();
+		}
+		else {
+			e.failed = true;
+		}
+		loadedCond.notify_all();
+	}
+
+	/* drops the least recently used images until the rest fit the budget
+	 * (the current one and edited ones stay no matter what). their memory really
+	 * goes back to the system, so the budget is what the cache actually holds */
+	void evict() {
+		while (bytes > budget) {
+			int victim = -1;
+			for (int i=0; i<(int)entries.size(); i++) {
+				CacheEntry& e = entries[i];
+				if (!e.image.pixels || e.edited || i == current) { continue; }
+				if (victim < 0 || e.lastUsed < entries[victim].lastUsed) { victim = i; }
+			}
+			if (victim < 0) { return; } //nothing left that may go
+			bytes -= entryBytes(entries[victim]);
+			entries[victim].image.release(false); //for real, a pooled buffer would still take up the memory
+		}
+	}
+
+	void prefetchLoop() {
+		unique_lock<mutex> lk(lock);
+		while (true) {
+			wantedCond.wait(lk, [&]{ return quitting || !wanted.empty(); });
+			if (quitting) { return; }
+			int i = wanted.back(); //the newest request is the likeliest to be wanted next
+			wanted.pop_back();
+			CacheEntry& e = entries[i];
+			if (e.image.pixels || e.loading || e.failed) { continue; }
+			load(e, lk);
+		}
+	}
+};
+
+static ImageStore& store() {
+	static ImageStore s;
+	return s;
+}
+
+/*	adds a file to the cache, reading only its header
+ *	returns its index, or -1 (after printing why) if it couldn't be opened */
+int cacheAdd(string path) {
+	return store().add(path);
+}
+
+int cacheCount() {
+	return store().count();
+}
+
+string cachePath(int index) {
+	return store().path(index);
+}
+
+/* size & format of an image, known without decoding it */
+ImageSpec cacheSpec(int index) {
+	return store().spec(index);
+}
+
+/*	the pixels of an image, decoded now if they aren't in memory already,
+ *	null if the file couldn't be read. it also becomes the most recently used
+ *	one, which is never evicted, so the pointer stays good until another image
+ *	is asked for (ask again each time rather than holding on to it) */
+ImageRGBA* cacheImage(int index) {
+	return store().get(index);
+}
+
+/* the image was changed in memory: keep it around for good instead of evicting it */
+void cacheEdited(int index) {
+	store().edited(index);
+}
+
+/*	decodes an image in the background so it's there when it's asked for
+ *	out of range indexes and ones already in memory are ignored */
+void cachePrefetch(int index) {
+	store().prefetch(index);
+}
+
+/* sets how many bytes of decoded pixels may be kept (GLOIIO_CACHE_MB, 1GB by default) */
+void setCacheBudget(size_t bytes) {
+	store().resize(bytes);
+}
+
+size_t cacheBytes() {
+	return store().used();
+}
@@ -0,0 +1,22 @@
+#ifndef GLOIIO_OB_CACHE_H
+#define GLOIIO_OB_CACHE_H
+#include "gloiioFuncs.h"
+
+//default memory budget for decoded images (MB), least recently viewed ones get dropped past it
+#define CACHE_BUDGET_MB 1024
+//environment variable that overrides it (same as setCacheBudget)
+#define CACHE_BUDGET_ENV "GLOIIO_CACHE_MB"
+//prefetch requests kept waiting, older ones are dropped (you've moved on since)
+#define CACHE_PREFETCH_DEPTH 2
+
+int cacheAdd(string);
+int cacheCount();
+string cachePath(int);
+ImageSpec cacheSpec(int);
+ImageRGBA* cacheImage(int);
+void cacheEdited(int);
+void cachePrefetch(int);
+void setCacheBudget(size_t);
+size_t cacheBytes();
+
+#endif
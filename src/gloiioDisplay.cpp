@@ -0,0 +1,199 @@
+#include "gloiioDisplay.h"
+#include <vector>
+
+#ifdef __APPLE__
+#  pragma clang diagnostic ignored "-Wdeprecated-declarations"
+#  include <GLUT/glut.h>
+#else
+#  include <GL/glut.h>
+#endif
+
+using namespace std;
+
+/** SHOWN IMAGE **/
+/*	the viewers used to push the whole image through glDrawPixels 30 times a second
+ *	whether anything changed or not. now the image sits in textures on the GL side,
+ *	tiles only get uploaded again after someone says they changed, and the window is
+ *	only redrawn when that happens (or GLUT asks, e.g. on a resize).
+ *	the textures hold one level of the shown image's pyramid, the one closest to
+ *	the zoom, and only tiles that are on screen get refreshed, uploaded or drawn,
+ *	so a frame costs about a window's worth of pixels however big the image is */
+static ImagePyramid ownPyramid; //for displayImage, which doesn't bring a pyramid
+static ImagePyramid* shown = nullptr;
+static int shownLevel = -1; //pyramid level in the textures, -1 = none yet
+static int levelWidth = 0, levelHeight = 0;
+static int tilesX = 0, tilesY = 0;
+static vector<GLuint> textures; //tilesX*tilesY, tile rows from the bottom like the pixels
+static vector<int> dirtyLo, dirtyHi; //per texture: level rows lo~hi need uploading (clean if lo >= hi)
+//window pixels per image pixel, and the image point (in level 0 pixels) at the window's bottom left
+static double viewZoom = 1.0, viewX = 0.0, viewY = 0.0;
+
+/* redraw as soon as GLUT gets around to it (if there's a window to redraw yet) */
+static void requestRedraw() {
+	if (glutGetWindow() != 0) {
+		glutPostRedisplay();
+	}
+}
+
+/*	shows pyr's image from now on (at whatever displayView says)
+ *	the pyramid has to stay put until something else is shown */
+void displayPyramid(ImagePyramid& pyr) {
+	shown = &pyr;
+	shownLevel = -1; //textures get redone on the next draw
+	requestRedraw();
+}
+
+/*	shows image at 100% from the bottom left corner of the window from now on
+ *	only the pixel pointer is kept, so moving the ImageRGBA around is fine
+ *	but it has to stay alive until something else is shown */
+void displayImage(const ImageRGBA& image) {
+	ownPyramid = makePyramid(image);
+	displayView(1.0, 0.0, 0.0);
+	displayPyramid(ownPyramid);
+}
+
+/* zoom is window pixels per image pixel, (x,y) the image pixel at the window's bottom left */
+void displayView(double zoom, double x, double y) {
+	viewZoom = zoom;
+	viewX = x;
+	viewY = y;
+	requestRedraw();
+}
+
+/* marks level rows y0~y1 of every texture they cross for uploading on the next draw */
+static void markRows(int y0, int y1) {
+	y0 = clampInt(y0, 0, levelHeight);
+	y1 = clampInt(y1, 0, levelHeight);
+	if (y0 >= y1) { return; }
+	for (int ty=y0/DISPLAY_TILE; ty<=(y1-1)/DISPLAY_TILE; ty++) {
+		int lo = (y0 > ty*DISPLAY_TILE)? y0 : ty*DISPLAY_TILE;
+		int hi = (y1 < (ty+1)*DISPLAY_TILE)? y1 : (ty+1)*DISPLAY_TILE;
+		for (int tx=0; tx<tilesX; tx++) {
+			int t = contigIndex(ty,tx,tilesX);
+			if (dirtyLo[t] >= dirtyHi[t]) {
+				dirtyLo[t] = lo;
+				dirtyHi[t] = hi;
+			}
+			else {
+				if (lo < dirtyLo[t]) { dirtyLo[t] = lo; }
+				if (hi > dirtyHi[t]) { dirtyHi[t] = hi; }
+			}
+		}
+	}
+}
+
+/* the whole shown image changed */
+void displayDirty() {
+	if (shown) {
+		displayDirtyRows(0, shown->base.spec.height);
+	}
+}
+
+/* rows y0~y1 of the shown image changed (counted from the bottom, like the pixels) */
+void displayDirtyRows(int y0, int y1) {
+	if (!shown || y0 >= y1) { return; }
+	pyramidDirtyRows(*shown, y0, y1);
+	if (shownLevel >= 0) {
+		markRows(y0 >> shownLevel, ((y1-1) >> shownLevel)+1);
+	}
+	requestRedraw();
+}
+
+/* (re)makes empty textures covering level of the shown pyramid, all of them dirty */
+static void makeTextures(int level) {
+	const ImageRGBA& image = pyramidLevel(*shown, level);
+	int tx = (image.spec.width+DISPLAY_TILE-1)/DISPLAY_TILE;
+	int ty = (image.spec.height+DISPLAY_TILE-1)/DISPLAY_TILE;
+	if (tx != tilesX || ty != tilesY) {
+		if (!textures.empty()) {
+			glDeleteTextures(textures.size(), textures.data());
+		}
+		tilesX = tx;
+		tilesY = ty;
+		textures.assign((size_t)tilesX*tilesY, 0);
+		if (!textures.empty()) {
+			glGenTextures(textures.size(), textures.data());
+		}
+		for (GLuint tex : textures) {
+			glBindTexture(GL_TEXTURE_2D, tex);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); //shrinking in between levels
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST); //zoomed in, see the pixels
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, DISPLAY_TILE, DISPLAY_TILE, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		}
+	}
+	shownLevel = level;
+	levelWidth = image.spec.width;
+	levelHeight = image.spec.height;
+	dirtyLo.assign(textures.size(), 0);
+	dirtyHi.assign(textures.size(), 0);
+	markRows(0, levelHeight);
+}
+
+/* sends texture t's dirty rows over, straight out of the level's pixmap (no repacking) */
+static void uploadTile(int t) {
+	int x0 = (t%tilesX)*DISPLAY_TILE;
+	int y0 = (t/tilesX)*DISPLAY_TILE;
+	int w = (x0+DISPLAY_TILE < levelWidth)? DISPLAY_TILE : levelWidth-x0;
+	pyramidRefresh(*shown, shownLevel, dirtyLo[t], dirtyHi[t]);
+	const ImageRGBA& image = pyramidLevel(*shown, shownLevel);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1); //Parrot Fixer 2000
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, levelWidth);
+	glPixelStorei(GL_UNPACK_SKIP_ROWS, dirtyLo[t]);
+	glPixelStorei(GL_UNPACK_SKIP_PIXELS, x0);
+	glBindTexture(GL_TEXTURE_2D, textures[t]);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, dirtyLo[t]-y0, w, dirtyHi[t]-dirtyLo[t], GL_RGBA, GL_UNSIGNED_BYTE, image.pixels);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+	glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+	dirtyLo[t] = dirtyHi[t] = 0;
+}
+
+/*	draws the on screen part of the shown image, uploading whatever changed there
+ *	since the last draw first. call from the display callback */
+void displayDraw() {
+	if (!shown) { return; }
+	//the smallest level that still has at least one pixel per window pixel
+	int level = 0;
+	int depth = pyramidDepth(*shown);
+	while (level+1 < depth && viewZoom*(1 << (level+1)) <= 1.0) {
+		level++;
+	}
+	if (level != shownLevel) {
+		makeTextures(level);
+	}
+	double scale = viewZoom*(1 << level); //window pixels per level pixel
+	double originX = -viewX*viewZoom, originY = -viewY*viewZoom; //where level pixel (0,0) lands
+	int winW = glutGet(GLUT_WINDOW_WIDTH);
+	int winH = glutGet(GLUT_WINDOW_HEIGHT);
+
+	//display alphamasked images properly via blending
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glEnable(GL_BLEND);
+	glEnable(GL_TEXTURE_2D);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+	for (int t=0; t<(int)textures.size(); t++) {
+		int x0 = (t%tilesX)*DISPLAY_TILE, y0 = (t/tilesX)*DISPLAY_TILE;
+		int w = (x0+DISPLAY_TILE < levelWidth)? DISPLAY_TILE : levelWidth-x0;
+		int h = (y0+DISPLAY_TILE < levelHeight)? DISPLAY_TILE : levelHeight-y0;
+		double left = originX + x0*scale, right = originX + (x0+w)*scale;
+		double bottom = originY + y0*scale, top = originY + (y0+h)*scale;
+		if (right <= 0 || left >= winW || top <= 0 || bottom >= winH) {
+			continue; //off screen, stays dirty until it's on
+		}
+		if (dirtyLo[t] < dirtyHi[t]) {
+			uploadTile(t);
+		}
+		double s = (double)w/DISPLAY_TILE, tt = (double)h/DISPLAY_TILE;
+		glBindTexture(GL_TEXTURE_2D, textures[t]);
+		glBegin(GL_QUADS);
+		glTexCoord2d(0,0); glVertex2d(left, bottom);
+		glTexCoord2d(s,0); glVertex2d(right, bottom);
+		glTexCoord2d(s,tt); glVertex2d(right, top);
+		glTexCoord2d(0,tt); glVertex2d(left, top);
+		glEnd();
+	}
+	glDisable(GL_TEXTURE_2D);
+	glDisable(GL_BLEND);
+}
@@ -0,0 +1,16 @@
+#ifndef GLOIIO_OB_DISPLAY_H
+#define GLOIIO_OB_DISPLAY_H
+#include "gloiioFuncs.h"
+#include "gloiioPyramid.h"
+
+//the shown image lives in textures this many pixels square (a power of two for old GL)
+#define DISPLAY_TILE 512
+
+void displayImage(const ImageRGBA&);
+void displayPyramid(ImagePyramid&);
+void displayView(double, double, double);
+void displayDirty();
+void displayDirtyRows(int, int);
+void displayDraw();
+
+#endif
@@ -0,0 +1,236 @@
+#include "gloiioFFT.h"
+#include "gloiioPool.h"
+#include <complex>
+#include <vector>
+
+typedef complex<double> cplx;
+
+/* smallest number >= x with no prime factors but 2, 3 and 5 */
+static int nextFastSize(int x) {
+	for (int n=(x > 1)? x : 1; ; n++) {
+		int m = n;
+		while (m%2 == 0) { m /= 2; }
+		while (m%3 == 0) { m /= 3; }
+		while (m%5 == 0) { m /= 5; }
+		if (m == 1) { return n; }
+	}
+}
+
+/** FFT **/
+/*	everything a transform of one length needs: the radices it splits into
+ *	(4s first, they're the cheapest per point) and e^(-2*pi*i*k/n) for every k */
+struct FFTPlan {
+	int n;
+	vector<int> radices;
+	vector<cplx> tw;
+};
+
+static FFTPlan makePlan(int n) {
+	FFTPlan plan;
+	plan.n = n;
+	int m = n;
+	while (m%4 == 0) { plan.radices.push_back(4); m /= 4; }
+	while (m%2 == 0) { plan.radices.push_back(2); m /= 2; }
+	while (m%3 == 0) { plan.radices.push_back(3); m /= 3; }
+	while (m%5 == 0) { plan.radices.push_back(5); m /= 5; }
+	plan.tw.resize(n);
+	for (int k=0; k<n; k++) {
+		double ang = -2*M_PI*k/n;
+		plan.tw[k] = cplx(cos(ang), sin(ang));
+	}
+	return plan;
+}
+
+/* a*b spelled out, std::complex's operator* goes through the slow
+ * NaN-checking routine unless built with -ffast-math */
+static inline cplx cmul(cplx a, cplx b) {
+	return cplx(a.real()*b.real() - a.imag()*b.imag(), a.real()*b.imag() + a.imag()*b.real());
+}
+
+/*	size R DFT of a, in place. root holds e^(-+2*pi*i*t/R) for t < R
+ *	the generic version is for 3 and 5, 2 and 4 only need adds */
+template<int R>
+static inline void smallDFT(cplx* a, const cplx* root, bool) {
+	cplx b[R];
+	for (int k=0; k<R; k++) {
+		b[k] = a[0];
+		for (int j=1; j<R; j++) { b[k] += cmul(a[j], root[(j*k)%R]); }
+	}
+	for (int k=0; k<R; k++) { a[k] = b[k]; }
+}
+template<>
+inline void smallDFT<2>(cplx* a, const cplx*, bool) {
+	cplx a0 = a[0];
+	a[0] = a0+a[1];
+	a[1] = a0-a[1];
+}
+template<>
+inline void smallDFT<4>(cplx* a, const cplx*, bool conj) {
+	cplx s02 = a[0]+a[2], d02 = a[0]-a[2];
+	cplx s13 = a[1]+a[3], d13 = a[1]-a[3];
+	//-i*d13 forward, +i*d13 inverse
+	cplx rot = conj? cplx(-d13.imag(), d13.real()) : cplx(d13.imag(), -d13.real());
+	a[0] = s02+s13;
+	a[1] = d02+rot;
+	a[2] = s02-s13;
+	a[3] = d02-rot;
+}
+
+/*	one radix-R pass of a Stockham (self-sorting) FFT, x -> y
+ *	len is the length of the sub-transforms still left, stride how many of them
+ *	are interleaved. each group of R points gets a size R DFT and is then
+ *	rotated by its twiddle. conj flips every twiddle for the inverse transform */
+template<int R>
+static void stockhamPass(const cplx* x, cplx* y, int len, int stride, const FFTPlan& plan, bool conj) {
+	int m = len/R;
+	int rootStep = plan.n/R;
+	cplx root[R];
+	for (int t=0; t<R; t++) {
+		root[t] = plan.tw[t*rootStep];
+		if (conj) { root[t] = std::conj(root[t]); }
+	}
+	for (int p=0; p<m; p++) {
+		cplx twp[R];
+		for (int k=0; k<R; k++) {
+			twp[k] = plan.tw[p*k*stride];
+			if (conj) { twp[k] = std::conj(twp[k]); }
+		}
+		for (int q=0; q<stride; q++) {
+			cplx a[R];
+			for (int j=0; j<R; j++) { a[j] = x[q + stride*(p + j*m)]; }
+			smallDFT<R>(a, root, conj);
+			y[q + stride*R*p] = a[0];
+			for (int k=1; k<R; k++) { y[q + stride*(R*p + k)] = cmul(a[k], twp[k]); }
+		}
+	}
+}
+
+/*	in-place FFT of plan.n contiguous values, scratch must hold plan.n as well
+ *	inverse transform is not divided by n, the caller folds that into its scale */
+static void fft(cplx* data, cplx* scratch, const FFTPlan& plan, bool inverse) {
+	cplx* x = data;
+	cplx* y = scratch;
+	int len = plan.n;
+	int stride = 1;
+	for (int r : plan.radices) {
+		switch (r) {
+			case 2: stockhamPass<2>(x, y, len, stride, plan, inverse); break;
+			case 3: stockhamPass<3>(x, y, len, stride, plan, inverse); break;
+			case 4: stockhamPass<4>(x, y, len, stride, plan, inverse); break;
+			case 5: stockhamPass<5>(x, y, len, stride, plan, inverse); break;
+		}
+		len /= r;
+		stride *= r;
+		swap(x, y);
+	}
+	//an odd number of passes leaves the answer in scratch
+	if (x != data) {
+		copy(x, x+plan.n, data);
+	}
+}
+
+/*	2D FFT of a pw x ph row-major grid: rows, then columns through a scratch copy
+ *	(a few columns at a time so the gather reads whole cache lines)
+ *	both passes are spread over the thread pool */
+static void fft2D(cplx* grid, int pw, int ph, bool inverse) {
+	const int block = 8;
+	FFTPlan rowPlan = makePlan(pw);
+	FFTPlan colPlan = makePlan(ph);
+	parallelRows(0, ph, [&](int y0, int y1) {
+		vector<cplx> scratch(pw);
+		for (int y=y0; y<y1; y++) {
+			fft(&grid[contigIndex(y,0,pw)], scratch.data(), rowPlan, inverse);
+		}
+	});
+	parallelRows(0, (pw+block-1)/block, [&](int b0, int b1) {
+		vector<cplx> columns((size_t)ph*block);
+		vector<cplx> scratch(ph);
+		for (int b=b0; b<b1; b++) {
+			int x0 = b*block;
+			int cols = (x0+block <= pw)? block : pw-x0;
+			for (int y=0; y<ph; y++) {
+				for (int c=0; c<cols; c++) { columns[contigIndex(c,y,ph)] = grid[contigIndex(y,x0+c,pw)]; }
+			}
+			for (int c=0; c<cols; c++) { fft(&columns[contigIndex(c,0,ph)], scratch.data(), colPlan, inverse); }
+			for (int y=0; y<ph; y++) {
+				for (int c=0; c<cols; c++) { grid[contigIndex(y,x0+c,pw)] = columns[contigIndex(c,y,ph)]; }
+			}
+		}
+	});
+}
+
+/** CONVOLUTION **/
+/*	rough cost model: true if the FFT path should beat the direct NxN loop
+ *	for an n x n filter on a width x height image */
+bool fftWorthIt(int n, int width, int height) {
+	double pts = (double)nextFastSize(width) * nextFastSize(height);
+	double direct = (double)width*height*n*n;
+	double viaFFT = FFT_COST_FACTOR * pts * log2(pts);
+	return viaFFT < direct;
+}
+
+/*	convolves the interior of victim (pixels whose window is inside the image)
+ *	in the frequency domain and writes it into result.
+ *	the grid is only padded to the next 2^a*3^b*5^c size, not width+N-1: wraparound
+ *	from the circular convolution only reaches the border ring, which the
+ *	caller fills in with the usual per-pixel padding anyway.
+ *	red & green ride in one complex grid (real & imaginary), blue in another */
+void convolveFFTInterior(RawFilter filt, const ImageRGBA& victim, pxRGBA* result) {
+	int n = filt.size;
+	int half = n/2;
+	int shift = n-1-half; //kernel row/col that lands on offset 0
+	int iwidth = victim.spec.width;
+	int iheight = victim.spec.height;
+	int pw = nextFastSize(iwidth);
+	int ph = nextFastSize(iheight);
+
+	vector<cplx> rg((size_t)pw*ph, cplx(0,0));
+	vector<cplx> bz((size_t)pw*ph, cplx(0,0));
+	vector<cplx> kern((size_t)pw*ph, cplx(0,0));
+	parallelRows(0, iheight, [&](int y0, int y1) {
+		for (int y=y0; y<y1; y++) {
+			for (int x=0; x<iwidth; x++) {
+				pxRGBA px = victim.pixels[contigIndex(y,x,iwidth)];
+				rg[contigIndex(y,x,pw)] = cplx(px.red, px.green);
+				bz[contigIndex(y,x,pw)] = cplx(px.blue, 0);
+			}
+		}
+	});
+	//kernel weight (a,b) shifts the image by (shift-a, shift-b), wrapped around the grid
+	for (int a=0; a<n; a++) {
+		for (int b=0; b<n; b++) {
+			int ky = ((a-shift)%ph+ph)%ph;
+			int kx = ((b-shift)%pw+pw)%pw;
+			kern[contigIndex(ky,kx,pw)] = filt.kernel[contigIndex(a,b,n)];
+		}
+	}
+
+	fft2D(rg.data(), pw, ph, false);
+	fft2D(bz.data(), pw, ph, false);
+	fft2D(kern.data(), pw, ph, false);
+	parallelRows(0, ph, [&](int y0, int y1) {
+		for (size_t i=(size_t)y0*pw; i<(size_t)y1*pw; i++) {
+			rg[i] = cmul(rg[i], kern[i]);
+			bz[i] = cmul(bz[i], kern[i]);
+		}
+	});
+	fft2D(rg.data(), pw, ph, true);
+	fft2D(bz.data(), pw, ph, true);
+
+	//undo the unnormalized inverse and apply the filter scale in one go
+	double norm = 1.0/((double)pw*ph*filt.scale);
+	parallelRows(half, iheight-half, [&](int y0, int y1) {
+		for (int y=y0; y<y1; y++) {
+			for (int x=half; x<iwidth-half; x++) {
+				cplx c1 = rg[contigIndex(y,x,pw)];
+				cplx c2 = bz[contigIndex(y,x,pw)];
+				int iindex = contigIndex(y,x,iwidth);
+				pxRGBA* npx = &result[iindex];
+				npx->red = (unsigned char)clampDouble(c1.real()*norm + FFT_ROUND_BIAS, 0, MAX_VAL);
+				npx->green = (unsigned char)clampDouble(c1.imag()*norm + FFT_ROUND_BIAS, 0, MAX_VAL);
+				npx->blue = (unsigned char)clampDouble(c2.real()*norm + FFT_ROUND_BIAS, 0, MAX_VAL);
+				npx->alpha = victim.pixels[iindex].alpha; //don't touch alpha
+			}
+		}
+	});
+}
@@ -0,0 +1,15 @@
+#ifndef GLOIIO_OB_FFT_H
+#define GLOIIO_OB_FFT_H
+#include "gloiioFuncs.h"
+
+//cost of the whole FFT path per point per log2(points), in units of one direct tap
+//(measured: five 2D transforms plus the column gathers come to ~10 taps' worth)
+#define FFT_COST_FACTOR 10.0
+//nudge added before truncating so values that should be whole numbers
+//(e.g. flat areas under a box filter) don't drop a level from rounding noise
+#define FFT_ROUND_BIAS 1e-6
+
+bool fftWorthIt(int, int, int);
+void convolveFFTInterior(RawFilter, const ImageRGBA&, pxRGBA*);
+
+#endif
@@ -1,14 +1,81 @@
 #include "gloiioFuncs.h"
+#include "gloiioPool.h"
+#include "gloiioSIMD.h"
+#include "gloiioFFT.h"
+#include "gloiioKey.h"
+#include "gloiioBlend.h"
+#include "gloiioRaw.h"
+#include "gloiioProfile.h"
+#include <cstring>
+
+/** IMAGE OWNERSHIP **/
+ImageRGBA::ImageRGBA(const ImageSpec& layout) : spec(layout), mapping(nullptr) {
+	bytes = (size_t)layout.width*layout.height*sizeof(pxRGBA);
+	pixels = (pxRGBA*)allocPixels(bytes);
+}
+/* the pixels are offset bytes into a length byte mapping, which is unmapped when the image goes */
+ImageRGBA::ImageRGBA(const ImageSpec& layout, void* base, size_t length, size_t offset)
+	: spec(layout), pixels((pxRGBA*)((char*)base+offset)), bytes(length), mapping(base) {}
+ImageRGBA::ImageRGBA(ImageRGBA&& other) noexcept : spec(std::move(other.spec)), pixels(other.pixels), bytes(other.bytes), mapping(other.mapping) {
+	other.pixels = nullptr;
+	other.bytes = 0;
+	other.mapping = nullptr;
+}
+ImageRGBA& ImageRGBA::operator=(ImageRGBA&& other) noexcept {
+	if (this != &other) {
+		release();
+		spec = std::move(other.spec);
+		pixels = other.pixels;
+		bytes = other.bytes;
+		mapping = other.mapping;
+		other.pixels = nullptr;
+		other.bytes = 0;
+		other.mapping = nullptr;
+	}
+	return *this;
+}
+
+ImageRGBA ImageRGBA::view() const {
+	return view(0, spec.height);
+}
+/* the spec says it's y1-y0 rows tall, everything else about it is the same */
+ImageRGBA ImageRGBA::view(int y0, int y1) const {
+	ImageRGBA rows;
+	rows.spec = spec;
+	rows.spec.height = y1-y0;
+	rows.spec.full_height = y1-y0;
+	rows.pixels = pixels + (size_t)y0*spec.width;
+	return rows;
+}
+
+/*	back to the pool with the pixels (or unmapped), the image is left empty
+ *	without reuse they're really freed instead of kept in the pool */
+void ImageRGBA::release(bool reuse) {
+	if (mapping) {
+		unmapPixelFile(mapping, bytes);
+	}
+	else if (bytes > 0 && reuse) {
+		releasePixels(pixels, bytes);
+	}
+	else if (bytes > 0) {
+		freePixels(pixels);
+	}
+	pixels = nullptr;
+	bytes = 0;
+	mapping = nullptr;
+}
 
 /** UTILITY FUNCTIONS **/
 /*	clean up memory of unneeded ImageRGBA
- *	note this will not deallocate the ImageSpec i don't think? */
-void discardImage(ImageRGBA image) {
-	delete[] image.pixels;
+ *	(images free themselves anyway, this is for freeing one early) */
+void discardImage(ImageRGBA& image) {
+	image.release();
 }
 /*	clean up memory of unneeded RawFilter */
 void discardRawFilter(RawFilter filt) {
 	delete[] filt.kernel;
+	delete[] filt.rowVec;
+	delete[] filt.colVec;
 }
 
 /* math functions i wasn't sure i could do as preprocessor macros */
@@ -116,11 +183,60 @@ pxHSV RGBAtoHSV(pxRGBA rgba) {
 }
 
 /** PROCESSING FUNCTIONS **/
+/*  fills in the channels the file didn't have, after decoding put its first
+	min(channels,4) channels in the leading bytes of every pxRGBA.
+	the switch is outside the loops so each loop is a straight vectorizable sweep */
+static void expandChannels(pxRGBA* px, size_t count, int channels) {
+	switch(channels) {
+		case 1: //grayscale, gray landed in red
+			for (size_t i=0; i<count; i++) {
+				px[i].green = px[i].red;
+				px[i].blue = px[i].red;
+				px[i].alpha = MAX_VAL;
+			}
+			break;
+		case 2: //weird grayscale with alpha, gray in red & alpha in green
+			for (size_t i=0; i<count; i++) {
+				px[i].alpha = px[i].green;
+				px[i].green = px[i].red;
+				px[i].blue = px[i].red;
+			}
+			break;
+		case 3: //RGB, just needs opaque alpha
+			for (size_t i=0; i<count; i++) {
+				px[i].alpha = MAX_VAL;
+			}
+			break;
+		default: //RGBA (or more, extra channels were never read)
+			break;
+	}
+}
+
 /*  reads in image from specified filename as RGBA 8bit pixmap
 	returns an ImageRGBA if successful
+	oiio decodes straight into the pixmap: each pixel's channels go in the leading
+	bytes of its pxRGBA (xstride of one pxRGBA) and rows go in bottom-up (negative
+	ystride), then the missing channels get filled in while those rows are still
+	in cache. no scratch copy of the image is ever made
 	THROWS EXCEPTION ON IO FAIL - place in trycatch block if called outside of init */
 ImageRGBA readImage(string filename) {
-	std::unique_ptr<ImageInput> in = ImageInput::open(filename);
+	ProfileScope scope("readImage");
+	//already decoded into the raw cache? then it's just a mapping (see gloiioRaw.h)
+	ImageRGBA cached;
+	bool hit;
+	{
+		PROFILE_SCOPE("readImage.rawcache");
+		hit = mapRawCached(filename, cached);
+	}
+	if (hit) {
+		scope.add((uint64_t)cached.spec.width*cached.spec.height, 0); //pages come in later, as they're touched
+		return cached;
+	}
+	std::unique_ptr<ImageInput> in;
+	{
+		PROFILE_SCOPE("readImage.open");
+		in = ImageInput::open(filename);
+	}
 	if (!in) {
 		std::cerr << "could not open input file! " << geterror();
 		//cancel routine
@@ -128,87 +244,87 @@ ImageRGBA readImage(string filename) {
 	}
 
 	//store spec and get metadata from it
-	ImageRGBA image;
-	image.spec = in->spec();
+	ImageRGBA image(in->spec());
 	int xr = image.spec.width;
 	int yr = image.spec.height;
 	int channels = image.spec.nchannels;
+	int readch = (channels < 4)? channels : 4; //channels that have a spot in pxRGBA
+	scope.add((uint64_t)xr*yr, (uint64_t)xr*yr*sizeof(pxRGBA));
 
-	//declare temp memory to read raw image data
-	unsigned char temp_px[xr*yr*channels];
-
-	// read the image into the temp_px from the input file, flipping it upside down using negative y-stride,
-	// since OpenGL pixmaps have the bottom scanline first, and 
-	// oiio expects the top scanline first in the image file.
-	int scanlinesize = xr * channels * sizeof(unsigned char);
-	if(!in->read_image(TypeDesc::UINT8, temp_px+((yr-1)*scanlinesize), AutoStride, -scanlinesize)){
+	// the file has the top scanline first, but OpenGL pixmaps have the bottom scanline first,
+	// so file row y goes into pixmap row yr-1-y and the y stride is negative
+	bool ok = true;
+	int chunk = image.spec.tile_width > 0? image.spec.tile_height : READ_CHUNK_ROWS; //rows decoded per read
+	stride_t xstride = sizeof(pxRGBA);
+	stride_t ystride = -(stride_t)xr*sizeof(pxRGBA);
+	for (int y=0; ok && y<yr; y+=chunk) {
+		int ye = (y+chunk < yr)? y+chunk : yr;
+		pxRGBA* dst = &image.pixels[contigIndex(yr-1-y,0,xr)];
+		uint64_t chunkPixels = (uint64_t)(ye-y)*xr;
+		{
+			PROFILE_SCOPE("readImage.decode", chunkPixels, chunkPixels*readch);
+			if (image.spec.tile_width > 0) {
+				//tiled files have to be read a whole row of tiles at once
+				ok = in->read_tiles(0, 0, image.spec.x, image.spec.x+xr, image.spec.y+y, image.spec.y+ye,
+					image.spec.z, image.spec.z+1, 0, readch, TypeDesc::UINT8, dst, xstride, ystride);
+			}
+			else {
+				ok = in->read_scanlines(0, 0, image.spec.y+y, image.spec.y+ye, image.spec.z,
+					0, readch, TypeDesc::UINT8, dst, xstride, ystride);
+			}
+		}
+		//the chunk is rows yr-ye ~ yr-1-y of the pixmap, contiguous
+		if (ok) {
+			PROFILE_SCOPE("readImage.expand", chunkPixels, chunkPixels*sizeof(pxRGBA)*2);
+			expandChannels(&image.pixels[contigIndex(yr-ye,0,xr)], (size_t)(ye-y)*xr, channels);
+		}
+	}
+	if (!ok) {
 		cerr << "Could not read image from " << filename << ", error = " << geterror() << endl;
 		//cancel routine
 		throw runtime_error("image input fail");
-  	}
-	
-	//allocate data for converted pxRGBA version
-	image.pixels = new pxRGBA[xr*yr];
-	//convert and store raw image data as pxRGBAs
-	for (int i=0; i<yr*xr; i++) {
-		switch(channels) {
-			//this could be more cleanly programmed but the less convoluted the better
-			case 1: //grayscale
-				image.pixels[i].red = temp_px[i];
-				image.pixels[i].green = temp_px[i];
-				image.pixels[i].blue = temp_px[i];
-				image.pixels[i].alpha = MAX_VAL;
-				break;
-			case 2: //weird grayscale with alpha (just covering my ass here)
-				image.pixels[i].red = temp_px[2*i];
-				image.pixels[i].green = temp_px[2*i];
-				image.pixels[i].blue = temp_px[2*i];
-				image.pixels[i].alpha = temp_px[(2*i)+1];
-				break;
-			case 3: //RGB
-				image.pixels[i].red = temp_px[(3*i)];
-				image.pixels[i].green = temp_px[(3*i)+1];
-				image.pixels[i].blue = temp_px[(3*i)+2];
-				image.pixels[i].alpha = MAX_VAL;
-				break;
-			case 4: //RGBA
-				image.pixels[i].red = temp_px[(4*i)];
-				image.pixels[i].green = temp_px[(4*i)+1];
-				image.pixels[i].blue = temp_px[(4*i)+2];
-				image.pixels[i].alpha = temp_px[(4*i)+3];
-				break;
-			default: //something weird, just do nothing
-				break;
-		}
 	}
 
 	//close input
 	in->close();
+	if (rawCacheAdds()) {
+		PROFILE_SCOPE("readImage.rawcacheWrite", (uint64_t)xr*yr, (uint64_t)xr*yr*sizeof(pxRGBA));
+		writeRawCached(filename, image);
+	}
 	return image;
 }
 
+/*	reads just the header of filename into spec, no pixels get decoded
+ *	returns false (after printing why) if the file can't be opened */
+bool readImageSpec(string filename, ImageSpec& spec) {
+	std::unique_ptr<ImageInput> in = ImageInput::open(filename);
+	if (!in) {
+		std::cerr << "could not open input file! " << geterror() << endl;
+		return false;
+	}
+	spec = in->spec();
+	in->close();
+	return true;
+}
+
 /* writes currently dixplayed pixmap (as RGBA) to a file
-	(mostly the same as sample code) */
-void writeImage(string filename, ImageRGBA image){
+	(mostly the same as sample code)
+	pxRGBA is already 4 tightly packed bytes, so scanlines go out straight from the pixmap
+	returns false (after printing why) if anything went wrong. quiet leaves out
+	the success message, for callers that report on their own (batch workers) */
+bool writeImage(string filename, const ImageRGBA& image, bool quiet){
+	static_assert(sizeof(pxRGBA) == 4, "pxRGBA must be 4 packed bytes");
 	int xr = image.spec.width;
 	int yr = image.spec.height;
 	int channels = 4;
-	//temporary 1d array to stick all the pxRGBA data into
-	//write_image does not like my structs >:(
-	unsigned char temp_px[xr*yr*channels];
-	for (int i=0; i<xr*yr; i++) {
-		temp_px[(4*i)] = image.pixels[i].red;
-		temp_px[(4*i)+1] = image.pixels[i].green;
-		temp_px[(4*i)+2] = image.pixels[i].blue;
-		temp_px[(4*i)+3] = image.pixels[i].alpha;
-	}
+	PROFILE_SCOPE("writeImage", (uint64_t)xr*yr, (uint64_t)xr*yr*sizeof(pxRGBA));
 
 	// create the oiio file handler for the image
 	std::unique_ptr<ImageOutput> outfile = ImageOutput::create(filename);
 	if(!outfile){
 		cerr << "could not create output file! " << geterror() << endl;
 		//cancel routine
-		return;
+		return false;
 	}
 
 	// open a file for writing the image. The file header will indicate an image of
@@ -217,25 +333,89 @@ void writeImage(string filename, ImageRGBA image){
 	ImageSpec spec(xr, yr, channels, TypeDesc::UINT8);
 	if(!outfile->open(filename, spec)){
 		cerr << "could not open output file! " << geterror() << endl;
-		return;
+		return false;
 	}
 
-	// write the image to the file. All channel values in the pixmap are taken to be
-	// unsigned chars. flip using stride to undo same effort in readImage
-	int scanlinesize = xr * channels * sizeof(unsigned char);
-	if(!outfile->write_image(TypeDesc::UINT8, temp_px+((yr-1)*scanlinesize), AutoStride, -scanlinesize)){
-		cerr << "could not write to file! " << geterror() << endl;
-		return;
+	// write the image to the file one scanline at a time, top first.
+	// flip by walking the pixmap backwards to undo same effort in readImage
+	for (int y=0; y<yr; y++) {
+		if(!outfile->write_scanline(y, 0, TypeDesc::UINT8, &image.pixels[contigIndex(yr-1-y,0,xr)])){
+			cerr << "could not write to file! " << geterror() << endl;
+			return false;
+		}
 	}
-	else cout << "successfully written image to " << filename << endl;
 
 	// close the image file after the image is written
 	if(!outfile->close()){
 		cerr << "could not close output file! " << geterror() << endl;
-		return;
+		return false;
+	}
+	if (!quiet) {
+		cout << "successfully written image to " << filename << endl;
+	}
+	return true;
+}
+
+
+/*	tries to split the kernel of filt into a column vector times a row vector
+ *	pivots on the largest weight so the division is as stable as possible;
+ *	fills in separable/rowVec/colVec (nullptr if the kernel is not rank 1) */
+static void factorFilter(RawFilter* filt) {
+	int n = filt->size;
+	filt->separable = false;
+	filt->rowVec = nullptr;
+	filt->colVec = nullptr;
+
+	//find the pivot (largest magnitude weight)
+	int prow = 0, pcol = 0;
+	double pmag = 0.0;
+	for (int r=0; r<n; r++) {
+		for (int c=0; c<n; c++) {
+			double mag = fabs(filt->kernel[contigIndex(r,c,n)]);
+			if (mag > pmag) {
+				pmag = mag;
+				prow = r;
+				pcol = c;
+			}
+		}
 	}
+	if (pmag == 0.0) { return; } //all zeroes, nothing worth splitting
+
+	//column through the pivot and row through the pivot (normalized by it)
+	double* col = new double[n];
+	double* row = new double[n];
+	double pivot = filt->kernel[contigIndex(prow,pcol,n)];
+	for (int i=0; i<n; i++) {
+		col[i] = filt->kernel[contigIndex(i,pcol,n)];
+		row[i] = filt->kernel[contigIndex(prow,i,n)] / pivot;
+	}
+
+	//rank 1 only if the outer product rebuilds every weight
+	for (int r=0; r<n; r++) {
+		for (int c=0; c<n; c++) {
+			double resid = fabs(filt->kernel[contigIndex(r,c,n)] - col[r]*row[c]);
+			if (resid > SEPARABLE_TOLERANCE*pmag) {
+				delete[] col;
+				delete[] row;
+				return;
+			}
+		}
+	}
+	filt->separable = true;
+	filt->rowVec = row;
+	filt->colVec = col;
 }
 
+/* true if every weight of the kernel is the same (and not 0), i.e. it's a box filter */
+static bool isUniform(RawFilter filt) {
+	int n = filt.size;
+	double first = filt.kernel[0];
+	if (first == 0.0) { return false; }
+	for (int i=1; i<n*n; i++) {
+		if (filt.kernel[i] != first) { return false; }
+	}
+	return true;
+}
 
 /*  reads in filter data from specified filename as RawFilter
 	returns a RawFilter for the filtCache if successful 
@@ -271,33 +451,114 @@ RawFilter readFilter(string filename) {
 	}
 	double max = (posMag>negMag)? posMag:negMag;
 	filt.scale = max;
+
+	//check if it can be applied as two 1D passes or running sums instead
+	factorFilter(&filt);
+	filt.uniform = isUniform(filt);
 	
 	return filt;
 }
 
-/* makes a copy of an image
+/*	the filter you'd get from applying filt times times in a row, as a single kernel
+ *	(times*(N-1)+1 wide): the kernel convolved with itself, scaled by filt's scale
+ *	to the times-th power. one pass with it matches the repeated passes except for
+ *	the rounding & clamping each pass would do in between (which is the point),
+ *	and near the border, where the bigger kernel reaches further past the edge */
+RawFilter composeFilter(RawFilter filt, int times) {
+	int n = filt.size;
+	RawFilter result;
+	result.size = n;
+	result.kernel = new double[n*n];
+	for (int i=0; i<n*n; i++) {
+		result.kernel[i] = filt.kernel[i];
+	}
+	result.scale = filt.scale;
+
+	for (int t=1; t<times; t++) {
+		//full 2D convolution of what we have so far with filt
+		int m = result.size;
+		int grown = m+n-1;
+		double* kernel = new double[grown*grown]();
+		for (int r=0; r<m; r++) {
+			for (int c=0; c<m; c++) {
+				double w = result.kernel[contigIndex(r,c,m)];
+				if (w == 0.0) { continue; }
+				for (int fr=0; fr<n; fr++) {
+					for (int fc=0; fc<n; fc++) {
+						kernel[contigIndex(r+fr,c+fc,grown)] += w*filt.kernel[contigIndex(fr,fc,n)];
+					}
+				}
+			}
+		}
+		delete[] result.kernel;
+		result.kernel = kernel;
+		result.size = grown;
+		result.scale *= filt.scale;
+	}
+
+	//repeating a separable filter keeps it separable, this picks that back up
+	factorFilter(&result);
+	result.uniform = isUniform(result);
+	return result;
+}
+
+/*	about what filt does, for an image shrunk factor times in each direction:
+ *	every weight lands on the tap nearest its offset divided by factor, so the
+ *	weights (and the scale) still add up the same but the kernel is only about
+ *	N/factor wide. good enough for a preview, not for the real thing */
+RawFilter shrinkFilter(RawFilter filt, int factor) {
+	int n = filt.size;
+	int half = n/2;
+	int shalf = (half+factor/2)/factor;
+	int m = 2*shalf+1;
+	RawFilter result;
+	result.size = m;
+	result.kernel = new double[m*m]();
+	result.scale = filt.scale;
+	for (int r=0; r<n; r++) {
+		int sr = shalf + (int)floor((double)(r-half)/factor + 0.5);
+		for (int c=0; c<n; c++) {
+			int sc = shalf + (int)floor((double)(c-half)/factor + 0.5);
+			result.kernel[contigIndex(sr,sc,m)] += filt.kernel[contigIndex(r,c,n)];
+		}
+	}
+	factorFilter(&result);
+	result.uniform = isUniform(result);
+	return result;
+}
+
+/* makes a copy of an image (or of what a view looks at, the copy is its own image)
  * useful to support reverting changes at the cost of extra memory usage 
  * if you don't like that, call readImage() again to get it from disk instead */
-ImageRGBA cloneImage(ImageRGBA origImage) {
-	ImageRGBA copyImage;
-	int h = origImage.spec.height;
-	int w = origImage.spec.width;
+ImageRGBA cloneImage(const ImageRGBA& origImage) {
+	uint64_t count = (uint64_t)origImage.spec.width*origImage.spec.height;
+	PROFILE_SCOPE("cloneImage", count, count*sizeof(pxRGBA)*2);
+	ImageRGBA copyImage(origImage.spec);
+	memcpy(copyImage.pixels, origImage.pixels, (size_t)origImage.spec.width*origImage.spec.height*sizeof(pxRGBA));
+	return copyImage;
+}
 
-	copyImage.spec = origImage.spec;
-	copyImage.pixels = new pxRGBA[h*w];
-	for (int i=0; i<h*w; i++) {
-		copyImage.pixels[i] = origImage.pixels[i];
+/* copies from's pixels over to's, which has to be the same size (no new memory)
+ * THROWS EXCEPTION if the sizes don't match */
+void copyPixels(const ImageRGBA& from, ImageRGBA& to) {
+	if (from.spec.width != to.spec.width || from.spec.height != to.spec.height) {
+		cerr << "can't copy a " << from.spec.width << "x" << from.spec.height << " image over a "
+			<< to.spec.width << "x" << to.spec.height << " one!" << endl;
+		throw runtime_error("image size mismatch");
 	}
-	return copyImage;
+	uint64_t count = (uint64_t)from.spec.width*from.spec.height;
+	PROFILE_SCOPE("copyPixels", count, count*sizeof(pxRGBA)*2);
+	memcpy(to.pixels, from.pixels, (size_t)from.spec.width*from.spec.height*sizeof(pxRGBA));
 }
 
 /** IMAGE MODIFICATION FUNCTIONS **/
 /* inverts all colors of the currently loaded image
 	ignores alpha channel */
-void invert(ImageRGBA image) {
+void invert(ImageRGBA& image) {
 	//wow!! this is a lot easier now
 	int xr = image.spec.width;
 	int yr = image.spec.height;
+	PROFILE_SCOPE("invert", (uint64_t)xr*yr, (uint64_t)xr*yr*sizeof(pxRGBA)*2);
 	for (int i=0; i<xr*yr; i++) {
 		image.pixels[i].red = MAX_VAL - image.pixels[i].red;
 		image.pixels[i].green = MAX_VAL - image.pixels[i].green;
@@ -307,13 +568,14 @@ void invert(ImageRGBA image) {
 
 /* randomly replaces pixels with black
 	chance defined by 1/noiseDenom */
-void noisify(ImageRGBA image, int noiseDenom, int seed) {
+void noisify(ImageRGBA& image, int noiseDenom, int seed) {
 	default_random_engine gen(time(NULL)+seed);
 	uniform_int_distribution<int> dist(1,noiseDenom);
 	auto rando = bind(dist,gen);
 	
 	int xr = image.spec.width;
 	int yr = image.spec.height;
+	PROFILE_SCOPE("noisify", (uint64_t)xr*yr, (uint64_t)xr*yr*sizeof(pxRGBA)*2);
 	for (int i=0; i<xr*yr; i++) {
 		if (rando() == 1) {
 			//set the color values to 0 and alpha to max
@@ -326,144 +588,482 @@ void noisify(ImageRGBA image, int noiseDenom, int seed) {
 }
 
 /* chroma-key image to create alphamask using HSV differences (overwrites)
-	"fuzz" arguments determine max difference for each value to keep */
-void chromaKey(ImageRGBA image, pxHSV target, double huefuzz, double satfuzz, double valfuzz) {
+	"fuzz" arguments determine max difference for each value to keep
+	colors go through a cached key table (see gloiioKey.h), GLOIIO_KEYLUT=off does the math per pixel */
+void chromaKey(ImageRGBA& image, pxHSV target, double huefuzz, double satfuzz, double valfuzz) {
 	int xr = image.spec.width;
 	int yr = image.spec.height;
+	PROFILE_SCOPE("chromaKey", (uint64_t)xr*yr, (uint64_t)xr*yr*sizeof(pxRGBA)*2);
+	shared_ptr<KeyTable> table = keyTableFor(target, huefuzz, satfuzz, valfuzz);
 	for (int i=0; i<xr*yr; i++) {
-		pxHSV comp = RGBAtoHSV(image.pixels[i]);
-		//cut out based on absolute distance from target values
-		//if all three are in range, hide it!
-		double huediff = fabs(comp.hue - target.hue);
-		double satdiff = fabs(comp.saturation - target.saturation);
-		double valdiff = fabs(comp.value - target.value);
-		if (huediff < huefuzz && satdiff < satfuzz && valdiff < valfuzz) {
-			//some smoothing function for pixels way less close
-			double maskalpha = (0.2*(huediff/huefuzz) + 0.4*(satdiff/satfuzz) + 0.4*(valdiff/valfuzz)) - 0.2;
-			//clamp to 0.0~1.0; if the result is like 0.012 don't bother with it
-			maskalpha = (maskalpha < 0.02? 0.0 : maskalpha);
-			maskalpha = (maskalpha > 1.0? 1.0 : maskalpha);
-			
-			//cout << "masking pixel: " << comp.hue << " " << comp.saturation << " " << comp.value << " to alpha value " << maskalpha << endl;
-			image.pixels[i].alpha = (unsigned char)255*maskalpha;
-		}
+		image.pixels[i].alpha = keyTableAlpha(table.get(), image.pixels[i]);
+	}
+}
+
+/*	calls rowOp(Arow, Brow, count) for every row of the part of B that A covers
+ *	when A's top left corner is put at (x,y) from B's top left (either can be negative
+ *	or hang off the far side, only the overlap is visited). rows are split over the pool
+ *	returns how many pixels that was */
+static uint64_t forOverlapRows(const ImageRGBA& A, ImageRGBA& B, int x, int y, const function<void(const pxRGBA*, pxRGBA*, int)>& rowOp) {
+	int widthA = A.spec.width, heightA = A.spec.height;
+	int widthB = B.spec.width, heightB = B.spec.height;
+	//overlap in B's columns, and in rows counted from the top
+	int x0 = (x > 0)? x : 0;
+	int x1 = (x+widthA < widthB)? x+widthA : widthB;
+	int top0 = (y > 0)? y : 0;
+	int top1 = (y+heightA < heightB)? y+heightA : heightB;
+	if (x0 >= x1 || top0 >= top1) {
+		return 0;
 	}
+	//pixels are stored bottom row first, so flip the row numbers for each image
+	parallelRows(top0, top1, [&](int t0, int t1) {
+		for (int top=t0; top<t1; top++) {
+			const pxRGBA* rowA = &A.pixels[contigIndex(heightA-1-(top-y), x0-x, widthA)];
+			pxRGBA* rowB = &B.pixels[contigIndex(heightB-1-top, x0, widthB)];
+			rowOp(rowA, rowB, x1-x0);
+		}
+	});
+	return (uint64_t)(x1-x0)*(top1-top0);
+}
+
+/* converts a blend mode name (over, in, out, atop, xor, plus, multiply, screen, add, difference)
+ * for command lines, unknown names warn and give BLEND_OVER */
+BlendMode blendModeFromName(string name) {
+	if (name == "over") { return BLEND_OVER; }
+	if (name == "in") { return BLEND_IN; }
+	if (name == "out") { return BLEND_OUT; }
+	if (name == "atop") { return BLEND_ATOP; }
+	if (name == "xor") { return BLEND_XOR; }
+	if (name == "plus") { return BLEND_PLUS; }
+	if (name == "multiply") { return BLEND_MULTIPLY; }
+	if (name == "screen") { return BLEND_SCREEN; }
+	if (name == "add") { return BLEND_ADD; }
+	if (name == "difference") { return BLEND_DIFFERENCE; }
+	cerr << "unknown blend mode " << name << ", using over" << endl;
+	return BLEND_OVER;
 }
 
 /* slap image A over image B, compositing them into just image B (overwrites)
-	both indices must be in bounds, A must be same size or smaller than B */
+	A's top left corner goes at (x,y) pixels from B's top left, anything hanging off B is cut off
+	only the rows & columns A covers are touched, so small A on a big B is cheap
+	mode picks how they're combined, over by default (see gloiioBlend.h) */
 /** IN MEMORIAM OF int Bindex, 2022-2022 */
-void compose(ImageRGBA imgA, ImageRGBA imgB) {
-	ImageRGBA* A = &imgA;
-	ImageRGBA* B = &imgB;
-	ImageSpec* specA = &(A->spec);
-	ImageSpec* specB = &(B->spec);
-	if (specA->height > specB->height || specA->width > specB->width) {
-		cerr << "foreground is too big to fit on background!" << endl;
-		return;
-	}
-	for (int i=0; i<specB->height*specB->width; i++) {
-		//make 0~1 value copies of pixels & their premultiplied versions
-		flRGBA pxpctA = percentify(A->pixels[i]);
-		flRGBA pxpctB = percentify(B->pixels[i]);
-		flRGBA prmpctA = percentify(premult(A->pixels[i]));
-		flRGBA prmpctB = percentify(premult(B->pixels[i]));
-		//apply over to each channel, overwriting background B
-		B->pixels[i].red = 255*(prmpctA.red + (1.0-pxpctA.alpha)*prmpctB.red);
-		B->pixels[i].green = 255*(prmpctA.green + (1.0-pxpctA.alpha)*prmpctB.green);
-		B->pixels[i].blue = 255*(prmpctA.blue + (1.0-pxpctA.alpha)*prmpctB.blue);
-		B->pixels[i].alpha = 255*(pxpctA.alpha + (1.0-pxpctA.alpha)*pxpctB.alpha);
-	}
+void compose(const ImageRGBA& imgA, ImageRGBA& imgB, int x, int y, BlendMode mode) {
+	ProfileScope scope("compose");
+	uint64_t count = forOverlapRows(imgA, imgB, x, y, [mode](const pxRGBA* rowA, pxRGBA* rowB, int count) {
+		blendRow(mode, rowA, rowB, count);
+	});
+	scope.add(count, count*sizeof(pxRGBA)*3); //A & B read, B written
 }
 
-/* apply convolution filter to current image, overwriting it when done
- * this function currently uses zero padding for boundaries
- * and clamps final values between 0 and MAX_VAL */
-void convolve(RawFilter filt, ImageRGBA victim) {
-	/* REMEMBER THE PIXMAPS ARE VERTICALLY FLIPPED - PIXEL 0 IS AT BOTTOM LEFT */
-	//flip the kernel horizontally and vertically before applying (read backwards)
-	int n = filt.size;
-	int nind = n-1; //IM STUPID AND SO ARE ORDINALS
-	double* tempkern = new double[n*n];
-	for (int row=0; row<n; row++) {
-		for (int col=0; col<n; col++) {
-			tempkern[contigIndex(row,col,n)] = filt.kernel[contigIndex(nind-row,nind-col,n)];
+/*	chromaKey fg and compose it onto bg at (x,y) in one go, into bg (overwrites, fg is untouched)
+ *	same result as chromaKey then compose, but the keyed foreground only ever
+ *	exists one row at a time, so it's one pass over the images instead of two */
+void keyAndCompose(const ImageRGBA& fg, ImageRGBA& bg, pxHSV target, double huefuzz, double satfuzz, double valfuzz, int x, int y, BlendMode mode) {
+	ProfileScope scope("keyAndCompose");
+	shared_ptr<KeyTable> table = keyTableFor(target, huefuzz, satfuzz, valfuzz);
+	uint64_t count = forOverlapRows(fg, bg, x, y, [&](const pxRGBA* fgRow, pxRGBA* bgRow, int count) {
+		//only one keyed row at a time, small enough to stay in cache for the over
+		thread_local vector<pxRGBA> keyed;
+		keyed.resize(count);
+		for (int icol=0; icol<count; icol++) {
+			keyed[icol] = fgRow[icol];
+			keyed[icol].alpha = keyTableAlpha(table.get(), fgRow[icol]);
 		}
+		blendRow(mode, keyed.data(), bgRow, count);
+	});
+	scope.add(count, count*sizeof(pxRGBA)*3);
+}
+
+/* convolve mode shared by every call, read from GLOIIO_CONVOLVE until someone sets it */
+static ConvolveMode convolveMode = convolveModeFromName(getenv(CONVOLVE_ENV)? getenv(CONVOLVE_ENV) : "auto");
+
+void setConvolveMode(ConvolveMode mode) {
+	convolveMode = mode;
+}
+ConvolveMode getConvolveMode() {
+	return convolveMode;
+}
+
+/* converts a mode name (auto, direct, separable, fixed, fft, box) for command lines & env vars
+ * unknown names warn and give CONVOLVE_AUTO */
+ConvolveMode convolveModeFromName(string name) {
+	if (name == "auto") { return CONVOLVE_AUTO; }
+	if (name == "direct") { return CONVOLVE_DIRECT; }
+	if (name == "separable") { return CONVOLVE_SEPARABLE; }
+	if (name == "fixed") { return CONVOLVE_FIXED; }
+	if (name == "fft") { return CONVOLVE_FFT; }
+	if (name == "box") { return CONVOLVE_BOX; }
+	cerr << "unknown convolve mode " << name << ", using auto" << endl;
+	return CONVOLVE_AUTO;
+}
+
+/* converts an edge mode name (center, zero, clamp, mirror, wrap) for command lines
+ * unknown names warn and give EDGE_CENTER */
+EdgeMode edgeModeFromName(string name) {
+	if (name == "center") { return EDGE_CENTER; }
+	if (name == "zero") { return EDGE_ZERO; }
+	if (name == "clamp") { return EDGE_CLAMP; }
+	if (name == "mirror") { return EDGE_MIRROR; }
+	if (name == "wrap") { return EDGE_WRAP; }
+	cerr << "unknown edge mode " << name << ", using center" << endl;
+	return EDGE_CENTER;
+}
+
+/* maps a row or column that may be outside 0~len-1 back into the image
+ * returns -1 if the edge mode doesn't read from the image (center, zero) */
+static int edgeIndex(int i, int len, EdgeMode edge) {
+	if (i >= 0 && i < len) { return i; }
+	switch (edge) {
+		case EDGE_CLAMP:
+			return clampInt(i, 0, len-1);
+		case EDGE_MIRROR: {
+			if (len == 1) { return 0; }
+			int period = 2*(len-1);
+			int m = ((i%period)+period)%period;
+			return (m < len)? m : period-m;
+		}
+		case EDGE_WRAP:
+			return ((i%len)+len)%len;
+		default:
+			return -1;
 	}
+}
 
+/* computes one output pixel near the border with the full NxN tap loop
+ * taps that land outside the image are looked up through the edge mode
+ * tempkern must already be flipped horizontally and vertically */
+static pxRGBA convolveEdgePixel(const double* tempkern, int n, double scale, const ImageRGBA& victim, int irow, int icol, EdgeMode edge) {
 	int iheight = victim.spec.height;
 	int iwidth = victim.spec.width;
-	int boundary = iheight*iwidth; //at this value, past the pixel array
-	//cout << "this image is " << iwidth << "x" << iheight << endl;
-	pxRGBA* result = new pxRGBA[iheight*iwidth]; //let's not do this entirely in-place
-	//per pixel...
-	for (int irow=0; irow<iheight; irow++) {
-		for (int icol=0; icol<iwidth; icol++) {
-			int iindex = contigIndex(irow,icol,iwidth);
-			pxRGBA itarget = (victim.pixels[iindex]); //image index
-			//bool debugCond = (iindex > boundary-(n) || iindex < n || iindex%iwidth == 0);
+	pxRGBA itarget = victim.pixels[contigIndex(irow,icol,iwidth)]; //image index
+
+	//per RGB channel...
+	double totalRed = 0.0;
+	double totalGreen = 0.0;
+	double totalBlue = 0.0;
 
-			//per RGB channel...
+	//per filter data point...
+	for (int frow=0; frow<n; frow++) {
+		int targetRow = edgeIndex(irow+(frow-(n/2)), iheight, edge);
+		for (int fcol=0; fcol<n; fcol++) {
+			int targetCol = edgeIndex(icol+(fcol-(n/2)), iwidth, edge);
+			double weight = tempkern[contigIndex(frow,fcol,n)];
+			pxRGBA ftarget;
+			if (targetRow >= 0 && targetCol >= 0) {
+				ftarget = victim.pixels[contigIndex(targetRow,targetCol,iwidth)];
+			}
+			else if (edge == EDGE_CENTER) {
+				ftarget = itarget; //pad with values of original pixel
+			}
+			else {
+				continue; //zero padding adds nothing
+			}
+			totalRed += (double)(ftarget.red) * weight;
+			totalGreen += (double)(ftarget.green) * weight;
+			totalBlue += (double)(ftarget.blue) * weight;
+		}
+	}
+	//scale, clamp, and apply to new pixel
+	pxRGBA npx;
+	npx.red = (unsigned char)clampDouble(totalRed/scale, 0, MAX_VAL);
+	npx.green = (unsigned char)clampDouble(totalGreen/scale, 0, MAX_VAL);
+	npx.blue = (unsigned char)clampDouble(totalBlue/scale, 0, MAX_VAL);
+	npx.alpha = itarget.alpha; //don't touch alpha
+	return npx;
+}
+
+/* full NxN double loop over rows y0~y1 of the image interior
+ * (columns whose window is inside the image), so no tap needs a bounds check */
+static void convolveDirectRows(const double* tempkern, RawFilter filt, const ImageRGBA& victim, pxRGBA* result, int y0, int y1) {
+	int n = filt.size;
+	int half = n/2;
+	int iwidth = victim.spec.width;
+	for (int irow=y0; irow<y1; irow++) {
+		for (int icol=half; icol<iwidth-half; icol++) {
 			double totalRed = 0.0;
 			double totalGreen = 0.0;
 			double totalBlue = 0.0;
-			
-			//per filter data point...
 			for (int frow=0; frow<n; frow++) {
+				const pxRGBA* tap = &victim.pixels[contigIndex(irow+frow-half,icol-half,iwidth)];
+				const double* w = &tempkern[contigIndex(frow,0,n)];
 				for (int fcol=0; fcol<n; fcol++) {
-					int targetRow = irow+(frow-(n/2));
-					int targetCol = icol+(fcol-(n/2));
-					double weight = tempkern[contigIndex(frow,fcol,n)];
-					int tindex = contigIndex(targetRow,targetCol,iwidth); //target (filter) index
-					//boundary check
-					//targetCol checks are to prevent bleeding of edge of last row or beginning of next row
-					if (tindex > 0 && tindex < boundary
-						&& targetCol >= 0 && targetCol < iwidth) {
-						pxRGBA ftarget = (victim.pixels[tindex]);
-						totalRed += (double)(ftarget.red) * weight;
-						totalGreen += (double)(ftarget.green) * weight;
-						totalBlue += (double)(ftarget.blue) * weight;
-						//if (debugCond) {
-						//	cout << "from " << targetRow << "," << targetCol << " (" << tindex << ", offset " << frow-(n/2) << "," << fcol-(n/2) << "): ";
-						//	cout << (double)(ftarget.red) << " " << (double)ftarget.green << " " << (double)ftarget.blue << ", " << weight << endl;
-						//}
-					}
-					else {
-						//if OOB, pad with values of original pixel
-						totalRed += (double)(itarget.red) * weight;
-						totalGreen += (double)(itarget.green) * weight;
-						totalBlue += (double)(itarget.blue) * weight;
-						//if (debugCond) {
-						//	cout << "out of bounds! ";
-						//	cout << "from " << targetRow << "," << targetCol << "(offset " << frow-(n/2) << "," << fcol-(n/2) << "): ";
-						//	cout << (double)itarget.red << " " << (double)itarget.green << " " << (double)itarget.blue << ", " << weight << endl;
-						//}
-					}
+					totalRed += (double)(tap[fcol].red) * w[fcol];
+					totalGreen += (double)(tap[fcol].green) * w[fcol];
+					totalBlue += (double)(tap[fcol].blue) * w[fcol];
 				}
 			}
-			//scale, clamp, and apply to new pixel
+			int iindex = contigIndex(irow,icol,iwidth);
 			pxRGBA* npx = &(result[iindex]);
 			npx->red = (unsigned char)clampDouble(totalRed/filt.scale, 0, MAX_VAL);
 			npx->green = (unsigned char)clampDouble(totalGreen/filt.scale, 0, MAX_VAL);
 			npx->blue = (unsigned char)clampDouble(totalBlue/filt.scale, 0, MAX_VAL);
 			npx->alpha = victim.pixels[iindex].alpha; //don't touch alpha
-			//if (debugCond) {
-			//	cout << "pixel: " << irow << "," << icol << " (" << iindex << ")" << endl;
-			//	cout << "totals: " << totalRed << " " << totalGreen << " " << totalBlue << ", scale " << filt.scale << endl;
-			//	cout << "final value: " << (int)npx->red << " " << (int)npx->green << " " << (int)npx->blue << " " << (int)npx->alpha << endl;
-			//}
 		}
 	}
+}
 
-	//copy result over victim.pixels
-	for (int i=0; i<iheight; i++) {
-		for (int j=0; j<iwidth; j++) {
-			int index = contigIndex(i,j,iwidth);
-			victim.pixels[index].red = result[index].red;
-			victim.pixels[index].green = result[index].green;
-			victim.pixels[index].blue = result[index].blue;
+/* two-pass (horizontal then vertical) convolution for a separable filter
+ * only fills rows y0~y1 and columns whose whole window is inside the image,
+ * the border ring is left to convolveEdgePixel since its padding is per-pixel.
+ * the horizontal pass is redone for the n/2 halo rows above & below the band
+ * so each band is self-contained */
+static void convolveSeparableRows(RawFilter filt, const ImageRGBA& victim, pxRGBA* result, int y0, int y1) {
+	int n = filt.size;
+	int half = n/2;
+	int iwidth = victim.spec.width;
+	int x0 = half;
+	int x1 = iwidth-half;
+	if (x1 <= x0 || y1 <= y0) { return; }
+
+	//flip the factors the same way the full kernel is flipped
+	double* hkern = new double[n];
+	double* vkern = new double[n];
+	for (int k=0; k<n; k++) {
+		hkern[k] = filt.rowVec[n-1-k];
+		vkern[k] = filt.colVec[n-1-k];
+	}
+
+	//horizontal pass: rows y0-half ~ y1+half, RGB interleaved as doubles
+	int hrows = (y1-y0)+2*half;
+	double* hbuf = new double[hrows*iwidth*3];
+	for (int hr=0; hr<hrows; hr++) {
+		const pxRGBA* src = &victim.pixels[contigIndex(y0-half+hr,0,iwidth)];
+		double* dst = &hbuf[contigIndex(hr,0,iwidth)*3];
+		for (int icol=x0; icol<x1; icol++) {
+			double totalRed = 0.0;
+			double totalGreen = 0.0;
+			double totalBlue = 0.0;
+			const pxRGBA* tap = &src[icol-half];
+			for (int k=0; k<n; k++) {
+				totalRed += (double)(tap[k].red) * hkern[k];
+				totalGreen += (double)(tap[k].green) * hkern[k];
+				totalBlue += (double)(tap[k].blue) * hkern[k];
+			}
+			dst[3*icol] = totalRed;
+			dst[3*icol+1] = totalGreen;
+			dst[3*icol+2] = totalBlue;
+		}
+	}
+
+	//vertical pass straight into the result
+	for (int irow=y0; irow<y1; irow++) {
+		for (int icol=x0; icol<x1; icol++) {
+			double totalRed = 0.0;
+			double totalGreen = 0.0;
+			double totalBlue = 0.0;
+			for (int k=0; k<n; k++) {
+				const double* tap = &hbuf[contigIndex(irow-y0+k,icol,iwidth)*3];
+				totalRed += tap[0] * vkern[k];
+				totalGreen += tap[1] * vkern[k];
+				totalBlue += tap[2] * vkern[k];
+			}
+			int iindex = contigIndex(irow,icol,iwidth);
+			pxRGBA* npx = &(result[iindex]);
+			npx->red = (unsigned char)clampDouble(totalRed/filt.scale, 0, MAX_VAL);
+			npx->green = (unsigned char)clampDouble(totalGreen/filt.scale, 0, MAX_VAL);
+			npx->blue = (unsigned char)clampDouble(totalBlue/filt.scale, 0, MAX_VAL);
+			npx->alpha = victim.pixels[iindex].alpha; //don't touch alpha
 		}
 	}
+	delete[] hkern;
+	delete[] vkern;
+	delete[] hbuf;
+}
+
+/*	box filter (every weight the same) for rows y0~y1 of result, border included
+ *	each window row's horizontal sums are slid along one column at a time, then the
+ *	window of rows is slid down the band the same way, so a pixel costs the same for
+ *	any N. sums are exact integers and taps outside the image follow the edge mode
+ *	like convolveEdgePixel, so the result matches the direct loop */
+static void convolveBoxRows(RawFilter filt, const ImageRGBA& victim, pxRGBA* result, int y0, int y1, EdgeMode edge) {
+	int n = filt.size;
+	int half = n/2;
+	int iheight = victim.spec.height;
+	int iwidth = victim.spec.width;
+	double weight = filt.kernel[0];
+
+	//horizontal r,g,b sums of every row a window in the band touches
+	int rows = (y1-y0) + 2*half;
+	vector<uint32_t> rowSums((size_t)rows*iwidth*3, 0);
+	for (int r=0; r<rows; r++) {
+		int srow = edgeIndex(y0-half+r, iheight, edge);
+		if (srow < 0) { continue; } //all zero (the center pixels get added in below)
+		const pxRGBA* src = &victim.pixels[contigIndex(srow,0,iwidth)];
+		uint32_t* sums = &rowSums[(size_t)r*iwidth*3];
+		uint32_t red = 0, green = 0, blue = 0;
+		for (int dx=-half; dx<=half; dx++) {
+			int scol = edgeIndex(dx, iwidth, edge);
+			if (scol >= 0) { red += src[scol].red; green += src[scol].green; blue += src[scol].blue; }
+		}
+		for (int icol=0; icol<iwidth; icol++) {
+			sums[3*icol] = red;
+			sums[3*icol+1] = green;
+			sums[3*icol+2] = blue;
+			int enter = edgeIndex(icol+half+1, iwidth, edge);
+			int leave = edgeIndex(icol-half, iwidth, edge);
+			if (enter >= 0) { red += src[enter].red; green += src[enter].green; blue += src[enter].blue; }
+			if (leave >= 0) { red -= src[leave].red; green -= src[leave].green; blue -= src[leave].blue; }
+		}
+	}
+
+	//slide the window of n rows down the band
+	vector<uint32_t> colSums((size_t)iwidth*3, 0);
+	for (int r=0; r<n; r++) {
+		for (int i=0; i<iwidth*3; i++) { colSums[i] += rowSums[(size_t)r*iwidth*3 + i]; }
+	}
+	for (int irow=y0; irow<y1; irow++) {
+		//center mode: every tap outside the image reads the pixel being computed
+		int rowsIn = ((irow+half < iheight)? irow+half : iheight-1) - ((irow-half > 0)? irow-half : 0) + 1;
+		for (int icol=0; icol<iwidth; icol++) {
+			pxRGBA itarget = victim.pixels[contigIndex(irow,icol,iwidth)];
+			double totalRed = colSums[3*icol];
+			double totalGreen = colSums[3*icol+1];
+			double totalBlue = colSums[3*icol+2];
+			if (edge == EDGE_CENTER) {
+				int colsIn = ((icol+half < iwidth)? icol+half : iwidth-1) - ((icol-half > 0)? icol-half : 0) + 1;
+				int outside = n*n - rowsIn*colsIn;
+				totalRed += outside*itarget.red;
+				totalGreen += outside*itarget.green;
+				totalBlue += outside*itarget.blue;
+			}
+			pxRGBA* out = &result[contigIndex(irow,icol,iwidth)];
+			out->red = (unsigned char)clampDouble(weight*totalRed/filt.scale, 0, MAX_VAL);
+			out->green = (unsigned char)clampDouble(weight*totalGreen/filt.scale, 0, MAX_VAL);
+			out->blue = (unsigned char)clampDouble(weight*totalBlue/filt.scale, 0, MAX_VAL);
+			out->alpha = itarget.alpha;
+		}
+		if (irow+1 < y1) {
+			const uint32_t* enter = &rowSums[(size_t)(irow-y0+n)*iwidth*3];
+			const uint32_t* leave = &rowSums[(size_t)(irow-y0)*iwidth*3];
+			for (int i=0; i<iwidth*3; i++) { colSums[i] += enter[i] - leave[i]; }
+		}
+	}
+}
+
+/*	rows y0~y1 of src convolved with filt, written to the same rows of dst (another
+ *	image the same size, alpha comes along from src untouched). src is only read,
+ *	so the rows can be done a band at a time in any order, e.g. in the background.
+ *	taps outside the image are read according to edge (see EdgeMode)
+ *	and final values are clamped between 0 and MAX_VAL.
+ *	the interior (pixels whose whole window is inside the image) runs without
+ *	any bounds checks: separable filters take two 1D passes (2N taps per pixel
+ *	instead of N^2), big non-separable ones go through the FFT when the cost
+ *	model says so, and the fixed point SIMD kernel is used if that mode was
+ *	picked (see setConvolveMode). only the border ring looks at the edge mode.
+ *	rows are split across the thread pool */
+void convolveRows(RawFilter filt, const ImageRGBA& src, ImageRGBA& dst, int y0, int y1, EdgeMode edge) {
+	/* REMEMBER THE PIXMAPS ARE VERTICALLY FLIPPED - PIXEL 0 IS AT BOTTOM LEFT */
+	//flip the kernel horizontally and vertically before applying (read backwards)
+	int n = filt.size;
+	int nind = n-1; //IM STUPID AND SO ARE ORDINALS
+	int half = n/2;
+	double* tempkern = new double[n*n];
+	for (int row=0; row<n; row++) {
+		for (int col=0; col<n; col++) {
+			tempkern[contigIndex(row,col,n)] = filt.kernel[contigIndex(nind-row,nind-col,n)];
+		}
+	}
+
+	int iheight = src.spec.height;
+	int iwidth = src.spec.width;
+	pxRGBA* result = dst.pixels;
+	y0 = clampInt(y0, 0, iheight);
+	y1 = clampInt(y1, 0, iheight);
+
+	//pick what computes the interior
+	ConvolveMode mode = convolveMode;
+	if (mode == CONVOLVE_AUTO) {
+		if (filt.uniform) { mode = CONVOLVE_BOX; }
+		else if (filt.separable) { mode = CONVOLVE_SEPARABLE; }
+		else if (fftWorthIt(n, iwidth, iheight)) { mode = CONVOLVE_FFT; }
+		else { mode = CONVOLVE_DIRECT; }
+	}
+	else if ((mode == CONVOLVE_SEPARABLE && !filt.separable) || (mode == CONVOLVE_BOX && !filt.uniform)) {
+		mode = CONVOLVE_DIRECT;
+	}
+	//one profile name per mode, so they can be told apart (same order as ConvolveMode)
+	static const char* const profileNames[] = {"convolveRows.auto", "convolveRows.direct",
+		"convolveRows.separable", "convolveRows.fixed", "convolveRows.fft", "convolveRows.box"};
+	uint64_t count = (uint64_t)(y1-y0)*iwidth;
+	uint64_t readRows = (y1 > y0)? clampInt(y1-y0+n-1, 0, iheight) : 0;
+	PROFILE_SCOPE(profileNames[mode], count, (readRows*iwidth+count)*sizeof(pxRGBA)); //window's worth of rows read, rows written
+	//too small to have an interior: everything is border
+	bool hasInterior = iwidth > 2*half && iheight > 2*half;
+	int interiorTop = hasInterior? iheight-half : 0;
+	int interiorRight = hasInterior? iwidth-half : 0;
+	FixedKernel fk;
+	if (hasInterior && mode == CONVOLVE_FIXED) {
+		fk = quantizeFilter(filt);
+	}
+	//the FFT does the whole interior of the rows at once (it spreads itself over the pool):
+	//given just the rows plus half a window above & below, their interior is what's asked for
+	int fy0 = (y0 > half)? y0 : half;
+	int fy1 = (y1 < interiorTop)? y1 : interiorTop;
+	if (hasInterior && mode == CONVOLVE_FFT && fy0 < fy1) {
+		convolveFFTInterior(filt, src.view(fy0-half, fy1+half), &result[contigIndex(fy0-half,0,iwidth)]);
+	}
+	//bands of rows go to the thread pool; every pixel only reads src and
+	//only writes its own spot in result, so any split gives identical output
+	parallelRows(y0, y1, [&](int b0, int b1) {
+		if (mode == CONVOLVE_BOX) {
+			convolveBoxRows(filt, src, result, b0, b1, edge); //border too
+			return;
+		}
+		int iy0 = (b0 > half)? b0 : half;
+		int iy1 = (b1 < interiorTop)? b1 : interiorTop;
+		if (iy0 < iy1) {
+			switch (mode) {
+				case CONVOLVE_SEPARABLE:
+					convolveSeparableRows(filt, src, result, iy0, iy1);
+					break;
+				case CONVOLVE_FIXED:
+					convolveFixedRows(fk, src, result, iy0, iy1);
+					break;
+				case CONVOLVE_FFT:
+					break; //already done
+				default:
+					convolveDirectRows(tempkern, filt, src, result, iy0, iy1);
+					break;
+			}
+		}
+		//border ring: whole rows at the top & bottom, both sides of the rest
+		for (int irow=b0; irow<b1; irow++) {
+			bool edgeRow = (irow < iy0 || irow >= iy1);
+			for (int icol=0; icol<iwidth; icol++) {
+				if (!edgeRow && icol == half) {
+					icol = interiorRight; //jump over the interior
+					if (icol >= iwidth) { break; }
+				}
+				result[contigIndex(irow,icol,iwidth)] = convolveEdgePixel(tempkern, n, filt.scale, src, irow, icol, edge);
+			}
+		}
+	}, (mode == CONVOLVE_BOX && n > MIN_BAND_ROWS)? n : MIN_BAND_ROWS); //box bands re-sum n-1 extra rows, keep them taller than that
+	if (hasInterior && mode == CONVOLVE_FIXED) {
+		discardFixedKernel(fk);
+	}
 	delete[] tempkern;
-	delete[] result;
-}
\ No newline at end of file
+}
+
+/* apply convolution filter to current image, overwriting it when done
+ * (convolveRows over the whole thing into a scratch copy, see there for how) */
+void convolve(RawFilter filt, ImageRGBA& victim, EdgeMode edge) {
+	int iheight = victim.spec.height;
+	int iwidth = victim.spec.width;
+	PROFILE_SCOPE("convolve", (uint64_t)iwidth*iheight, (uint64_t)iwidth*iheight*sizeof(pxRGBA)*4);
+	ImageRGBA scratch(victim.spec); //let's not do this entirely in-place
+	convolveRows(filt, victim, scratch, 0, iheight, edge);
+	pxRGBA* result = scratch.pixels;
+
+	//copy result over victim.pixels
+	parallelRows(0, iheight, [&](int y0, int y1) {
+		for (int i=y0; i<y1; i++) {
+			for (int j=0; j<iwidth; j++) {
+				int index = contigIndex(i,j,iwidth);
+				victim.pixels[index].red = result[index].red;
+				victim.pixels[index].green = result[index].green;
+				victim.pixels[index].blue = result[index].blue;
+			}
+		}
+	});
+}
@@ -8,12 +8,19 @@
 #include <random>
 #include <algorithm>
 #include <exception>
+#include "gloiioAlloc.h"
 
 using namespace std;
 OIIO_NAMESPACE_USING;
 
 //assumed maximum value of pixel data - don't touch it kiddo
 #define MAX_VAL 255
+//max residual (relative to largest weight) for a kernel to still count as separable
+#define SEPARABLE_TOLERANCE 1e-9
+//scanlines readImage decodes per call for untiled files (tiled ones go a row of tiles at a time)
+#define READ_CHUNK_ROWS 64
+//environment variable that picks the convolve mode (see ConvolveMode names)
+#define CONVOLVE_ENV "GLOIIO_CONVOLVE"
 //preprocess macros aka math shorthand
 #define percentOf(a,max) ((double)(a)/(max))
 #define contigIndex(row,col,wid) (((row)*(wid))+(col)) //converts row & column into 1d array index
@@ -37,19 +44,76 @@ typedef struct floating_rgba_t {
 	double red, green, blue, alpha;
 } flRGBA;
 
-//struct to tie image spec and pixels together
-typedef struct image_rgba_uint8_t {
+//image spec and pixels tied together (pixels go bottom row first, PIXEL_ALIGN aligned)
+//an image owns its pixels and hands them back to the pixel pool (gloiioAlloc.h) when
+//it goes away (or unmaps them, if they're in a mapped file, see gloiioRaw.h),
+//so it can be moved around but not copied (cloneImage does that).
+//views just look at somebody else's pixels and never free them
+struct ImageRGBA {
 	ImageSpec spec;
 	pxRGBA* pixels;
-} ImageRGBA;
+
+	ImageRGBA() : pixels(nullptr), bytes(0), mapping(nullptr) {}
+	explicit ImageRGBA(const ImageSpec&); //new image the size of the spec, pixels are garbage
+	ImageRGBA(const ImageSpec&, void*, size_t, size_t); //takes over a mapPixelFile mapping, pixels start at the offset
+	ImageRGBA(ImageRGBA&&) noexcept;
+	ImageRGBA& operator=(ImageRGBA&&) noexcept;
+	ImageRGBA(const ImageRGBA&) = delete;
+	ImageRGBA& operator=(const ImageRGBA&) = delete;
+	~ImageRGBA() { release(); }
+
+	ImageRGBA view() const; //all of it
+	ImageRGBA view(int, int) const; //rows y0~y1 (counted from the bottom, like the pixels)
+	void release(bool reuse = true); //frees the pixels now (a view just forgets them), reuse = false skips the pool
+private:
+	size_t bytes; //size of the owned buffer (or mapping), 0 for views & empty images
+	void* mapping; //start of the mapped file the pixels are in, nullptr if they're pooled
+};
 //struct representing .filt with calculated scale factor
 typedef struct convolve_filt_t {
 	int size; //NxN
 	double scale;
 	double* kernel;
+	bool separable; //true if kernel == colVec x rowVec (rank 1)
+	double* rowVec; //horizontal factor (N), nullptr if not separable
+	double* colVec; //vertical factor (N), nullptr if not separable
+	bool uniform; //true if every weight is the same (a box filter)
 } RawFilter;
 
-void discardImage(ImageRGBA);
+//how convolve computes the interior of the image (the border ring always uses the double loop)
+typedef enum convolve_mode_t {
+	CONVOLVE_AUTO, //box or separable if the filter allows it, otherwise fft or direct by cost
+	CONVOLVE_DIRECT, //full NxN double loop
+	CONVOLVE_SEPARABLE, //two 1D double passes (direct if the filter isn't separable)
+	CONVOLVE_FIXED, //16 bit fixed point SIMD kernel, see FixedKernel for its error bound
+	CONVOLVE_FFT, //frequency domain, cost doesn't depend on N
+	CONVOLVE_BOX //running sums over the whole image incl. border (direct if the filter isn't uniform)
+} ConvolveMode;
+
+//what convolve reads for taps that fall outside the image
+typedef enum edge_mode_t {
+	EDGE_CENTER, //the pixel being computed (original behavior)
+	EDGE_ZERO, //black, contributes nothing
+	EDGE_CLAMP, //nearest edge pixel
+	EDGE_MIRROR, //reflected back in at the edge (edge pixel not repeated)
+	EDGE_WRAP //from the opposite side of the image
+} EdgeMode;
+
+//how compose combines A with B (Porter-Duff operators, then separable blend modes)
+typedef enum blend_mode_t {
+	BLEND_OVER, //A on top of B (original behavior)
+	BLEND_IN, //A only where B is
+	BLEND_OUT, //A only where B isn't
+	BLEND_ATOP, //A on top of B, but only where B is
+	BLEND_XOR, //A where B isn't and B where A isn't
+	BLEND_PLUS, //A and B added up
+	BLEND_MULTIPLY, //colors multiplied (darkens)
+	BLEND_SCREEN, //inverted colors multiplied (lightens)
+	BLEND_ADD, //colors added where they overlap (lightens, clipped at white)
+	BLEND_DIFFERENCE //colors subtracted where they overlap
+} BlendMode;
+
+void discardImage(ImageRGBA&);
 void discardRawFilter(RawFilter);
 int clampInt(int,int,int);
 double clampDouble(double,double,double);
@@ -61,13 +125,24 @@ pxRGBA premult(pxRGBA);
 pxHSV RGBtoHSV(pxRGB);
 pxHSV RGBAtoHSV(pxRGBA);
 ImageRGBA readImage(string);
-void writeImage(string, ImageRGBA);
+bool readImageSpec(string, ImageSpec&);
+bool writeImage(string, const ImageRGBA&, bool quiet = false);
 RawFilter readFilter(string);
-ImageRGBA cloneImage(ImageRGBA);
-void invert(ImageRGBA);
-void noisify(ImageRGBA, int, int);
-void chromaKey(ImageRGBA, pxHSV, double, double, double);
-void compose(ImageRGBA, ImageRGBA);
-void convolve(RawFilter, ImageRGBA);
+RawFilter composeFilter(RawFilter, int);
+RawFilter shrinkFilter(RawFilter, int);
+ImageRGBA cloneImage(const ImageRGBA&);
+void copyPixels(const ImageRGBA&, ImageRGBA&);
+void invert(ImageRGBA&);
+void noisify(ImageRGBA&, int, int);
+void chromaKey(ImageRGBA&, pxHSV, double, double, double);
+BlendMode blendModeFromName(string);
+void compose(const ImageRGBA&, ImageRGBA&, int x = 0, int y = 0, BlendMode mode = BLEND_OVER);
+void keyAndCompose(const ImageRGBA&, ImageRGBA&, pxHSV, double, double, double, int x = 0, int y = 0, BlendMode mode = BLEND_OVER);
+void setConvolveMode(ConvolveMode);
+ConvolveMode getConvolveMode();
+ConvolveMode convolveModeFromName(string);
+EdgeMode edgeModeFromName(string);
+void convolveRows(RawFilter, const ImageRGBA&, ImageRGBA&, int, int, EdgeMode edge = EDGE_CENTER);
+void convolve(RawFilter, ImageRGBA&, EdgeMode edge = EDGE_CENTER);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include "gloiioHistory.h"
+#include "gloiioPool.h"
+#include <cstring>
+
+/** TILES **/
+/* where tile t sits in the image: bottom left corner & size in pixels */
+static void tileRect(const ImageHistory& hist, int t, int* x0, int* y0, int* w, int* h) {
+	*x0 = (t%hist.tilesX)*HISTORY_TILE;
+	*y0 = (t/hist.tilesX)*HISTORY_TILE;
+	*w = (*x0+HISTORY_TILE < hist.width)? HISTORY_TILE : hist.width-*x0;
+	*h = (*y0+HISTORY_TILE < hist.height)? HISTORY_TILE : hist.height-*y0;
+}
+
+static size_t tileBytes(const HistoryTile& tile) {
+	return (size_t)tile->spec.width*tile->spec.height*sizeof(pxRGBA);
+}
+
+/* copies tile t out of image (tiles come out of the pixel pool like images do) */
+static HistoryTile grabTile(const ImageHistory& hist, int t, const ImageRGBA& image) {
+	int x0, y0, w, h;
+	tileRect(hist, t, &x0, &y0, &w, &h);
+	shared_ptr<ImageRGBA> tile = make_shared<ImageRGBA>(ImageSpec(w, h, 4, TypeDesc::UINT8));
+	for (int row=0; row<h; row++) {
+		memcpy(&tile->pixels[contigIndex(row,0,w)], &image.pixels[contigIndex(y0+row,x0,hist.width)], w*sizeof(pxRGBA));
+	}
+	return tile;
+}
+
+/* copies a saved tile back into its spot in image */
+static void putTile(const ImageHistory& hist, int t, const HistoryTile& tile, ImageRGBA& image) {
+	int x0, y0, w, h;
+	tileRect(hist, t, &x0, &y0, &w, &h);
+	for (int row=0; row<h; row++) {
+		memcpy(&image.pixels[contigIndex(y0+row,x0,hist.width)], &tile->pixels[contigIndex(row,0,w)], w*sizeof(pxRGBA));
+	}
+}
+
+/* true if tile t of image still has exactly the pixels of tile */
+static bool tileMatches(const ImageHistory& hist, int t, const HistoryTile& tile, const ImageRGBA& image) {
+	int x0, y0, w, h;
+	tileRect(hist, t, &x0, &y0, &w, &h);
+	for (int row=0; row<h; row++) {
+		if (memcmp(&tile->pixels[contigIndex(row,0,w)], &image.pixels[contigIndex(y0+row,x0,hist.width)], w*sizeof(pxRGBA)) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/** HISTORY **/
+/* history whose only state is image as it is now
+ * budget is how many bytes of tiles the history may hold before old states get dropped */
+ImageHistory startHistory(const ImageRGBA& image, size_t budget) {
+	ImageHistory hist;
+	hist.width = image.spec.width;
+	hist.height = image.spec.height;
+	hist.tilesX = (hist.width+HISTORY_TILE-1)/HISTORY_TILE;
+	hist.tilesY = (hist.height+HISTORY_TILE-1)/HISTORY_TILE;
+	hist.current = 0;
+	hist.budget = budget;
+
+	HistoryState first;
+	first.tiles.resize((size_t)hist.tilesX*hist.tilesY);
+	parallelRows(0, hist.tilesY, [&](int ty0, int ty1) {
+		for (int t=ty0*hist.tilesX; t<ty1*hist.tilesX; t++) {
+			first.tiles[t] = grabTile(hist, t, image);
+		}
+	}, 1);
+	first.ownBytes = (size_t)hist.width*hist.height*sizeof(pxRGBA);
+	hist.bytes = first.ownBytes;
+	hist.states.push_back(std::move(first));
+	return hist;
+}
+
+/* forgets the oldest state. the next one now owns every tile it used to share with it */
+static void dropOldest(ImageHistory& hist) {
+	hist.bytes -= hist.states.front().ownBytes;
+	hist.states.pop_front();
+	hist.current--;
+	HistoryState& front = hist.states.front();
+	hist.bytes -= front.ownBytes;
+	front.ownBytes = (size_t)hist.width*hist.height*sizeof(pxRGBA);
+	hist.bytes += front.ownBytes;
+}
+
+/*	image (the state after an edit) as a version to go after the current one:
+ *	tiles that are byte for byte the same as the current state's are shared with
+ *	it instead of copied. the history itself isn't changed, so this (the part that
+ *	looks at every pixel) can run on another thread as long as nobody commits,
+ *	undoes or redoes meanwhile. addHistoryState saves it
+ *	THROWS EXCEPTION if image isn't the size the history was started with */
+HistoryState makeHistoryState(const ImageHistory& hist, const ImageRGBA& image) {
+	if (image.spec.width != hist.width || image.spec.height != hist.height) {
+		cerr << "can't save a " << image.spec.width << "x" << image.spec.height << " image in the history of a "
+			<< hist.width << "x" << hist.height << " one!" << endl;
+		throw runtime_error("history size mismatch");
+	}
+	const HistoryState& prev = hist.states[hist.current];
+	HistoryState next;
+	next.tiles.resize(prev.tiles.size());
+	parallelRows(0, hist.tilesY, [&](int ty0, int ty1) {
+		for (int t=ty0*hist.tilesX; t<ty1*hist.tilesX; t++) {
+			next.tiles[t] = tileMatches(hist, t, prev.tiles[t], image)? prev.tiles[t] : grabTile(hist, t, image);
+		}
+	}, 1);
+	next.ownBytes = 0;
+	for (size_t t=0; t<next.tiles.size(); t++) {
+		if (next.tiles[t] != prev.tiles[t]) { next.ownBytes += tileBytes(next.tiles[t]); }
+	}
+	return next;
+}
+
+/*	saves a state from makeHistoryState (made from the current one) right after
+ *	the current one. anything that could have been redone is thrown away, then the
+ *	oldest states go until the history fits its budget (the newest always stays) */
+void addHistoryState(ImageHistory& hist, HistoryState next) {
+	while ((int)hist.states.size() > hist.current+1) {
+		hist.bytes -= hist.states.back().ownBytes;
+		hist.states.pop_back();
+	}
+	hist.bytes += next.ownBytes;
+	hist.states.push_back(std::move(next));
+	hist.current++;
+
+	while (hist.bytes > hist.budget && hist.current > 0) {
+		dropOldest(hist);
+	}
+}
+
+/*	saves image (the current state after an edit) as a new state after the current one
+ *	THROWS EXCEPTION if image isn't the size the history was started with */
+void commitHistory(ImageHistory& hist, const ImageRGBA& image) {
+	addHistoryState(hist, makeHistoryState(hist, image));
+}
+
+/* puts image (which is at state from) back to state to, only the tiles that differ get copied */
+static void restoreState(ImageHistory& hist, int from, int to, ImageRGBA& image) {
+	const HistoryState& have = hist.states[from];
+	const HistoryState& want = hist.states[to];
+	parallelRows(0, hist.tilesY, [&](int ty0, int ty1) {
+		for (int t=ty0*hist.tilesX; t<ty1*hist.tilesX; t++) {
+			if (have.tiles[t] != want.tiles[t]) { putTile(hist, t, want.tiles[t], image); }
+		}
+	}, 1);
+	hist.current = to;
+}
+
+/* steps image (at the current state) back one state, false if there's nothing older left */
+bool undoHistory(ImageHistory& hist, ImageRGBA& image) {
+	if (hist.current == 0) { return false; }
+	restoreState(hist, hist.current, hist.current-1, image);
+	return true;
+}
+
+/* steps image forward again after an undo, false if there's nothing to redo */
+bool redoHistory(ImageHistory& hist, ImageRGBA& image) {
+	if (hist.current+1 >= (int)hist.states.size()) { return false; }
+	restoreState(hist, hist.current, hist.current+1, image);
+	return true;
+}
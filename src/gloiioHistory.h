@@ -0,0 +1,40 @@
+#ifndef GLOIIO_OB_HISTORY_H
+#define GLOIIO_OB_HISTORY_H
+#include "gloiioFuncs.h"
+#include <deque>
+#include <memory>
+#include <vector>
+
+//history tiles are this many pixels square (16KB, the ones on the far edges are smaller)
+#define HISTORY_TILE 64
+//default memory budget for saved versions (MB), oldest ones get dropped past it
+#define HISTORY_BUDGET_MB 256
+
+//one tile of a saved version, shared by every version after it that didn't change it
+typedef shared_ptr<const ImageRGBA> HistoryTile;
+
+//one saved version of the image
+typedef struct history_state_t {
+	vector<HistoryTile> tiles; //tile rows from the bottom, like the pixels
+	size_t ownBytes; //bytes of the tiles this version doesn't share with the one before it
+} HistoryState;
+
+//undo/redo stack for one image: versions only copy the tiles that changed from
+//the version before them, so history costs about what each edit touched
+typedef struct image_history_t {
+	int width, height;
+	int tilesX, tilesY;
+	deque<HistoryState> states; //oldest first
+	int current; //which state the image is at right now
+	size_t bytes; //tile memory held by all the states
+	size_t budget; //bytes the states may use before the oldest go
+} ImageHistory;
+
+ImageHistory startHistory(const ImageRGBA&, size_t budget = (size_t)HISTORY_BUDGET_MB*1024*1024);
+void commitHistory(ImageHistory&, const ImageRGBA&);
+HistoryState makeHistoryState(const ImageHistory&, const ImageRGBA&);
+void addHistoryState(ImageHistory&, HistoryState);
+bool undoHistory(ImageHistory&, ImageRGBA&);
+bool redoHistory(ImageHistory&, ImageRGBA&);
+
+#endif
@@ -0,0 +1,153 @@
+#include "gloiioKey.h"
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+/** MODE **/
+/* key table mode shared by every call, read from GLOIIO_KEYLUT until someone sets it */
+static KeyLutMode keyLutMode = keyLutModeFromName(getenv(KEYLUT_ENV)? getenv(KEYLUT_ENV) : "exact");
+
+void setKeyLutMode(KeyLutMode mode) {
+	keyLutMode = mode;
+}
+KeyLutMode getKeyLutMode() {
+	return keyLutMode;
+}
+
+/* converts a mode name (exact, grid, off) for command lines & env vars
+ * unknown names warn and give KEYLUT_EXACT */
+KeyLutMode keyLutModeFromName(string name) {
+	if (name == "exact") { return KEYLUT_EXACT; }
+	if (name == "grid") { return KEYLUT_GRID; }
+	if (name == "off") { return KEYLUT_OFF; }
+	cerr << "unknown key table mode " << name << ", using exact" << endl;
+	return KEYLUT_EXACT;
+}
+
+/** KEYING MATH **/
+/* the alpha chromaKey gives one pixel: its own alpha unless it's close enough to target */
+unsigned char keyAlpha(pxRGBA px, pxHSV target, double huefuzz, double satfuzz, double valfuzz) {
+	pxHSV comp = RGBAtoHSV(px);
+	//cut out based on absolute distance from target values
+	//if all three are in range, hide it!
+	double huediff = fabs(comp.hue - target.hue);
+	double satdiff = fabs(comp.saturation - target.saturation);
+	double valdiff = fabs(comp.value - target.value);
+	if (huediff < huefuzz && satdiff < satfuzz && valdiff < valfuzz) {
+		//some smoothing function for pixels way less close
+		double maskalpha = (0.2*(huediff/huefuzz) + 0.4*(satdiff/satfuzz) + 0.4*(valdiff/valfuzz)) - 0.2;
+		//clamp to 0.0~1.0; if the result is like 0.012 don't bother with it
+		maskalpha = (maskalpha < 0.02? 0.0 : maskalpha);
+		maskalpha = (maskalpha > 1.0? 1.0 : maskalpha);
+		return (unsigned char)255*maskalpha;
+	}
+	return px.alpha;
+}
+
+/* table entry for a color: 0 keeps the pixel's alpha, otherwise alpha+1
+ * (works out whether it's keyed by asking with two different alphas) */
+static int keyEntry(KeyTable* table, unsigned char r, unsigned char g, unsigned char b) {
+	pxHSV fz = table->fuzz;
+	unsigned char a0 = keyAlpha(linkRGBA(r,g,b,0), table->target, fz.hue, fz.saturation, fz.value);
+	unsigned char a1 = keyAlpha(linkRGBA(r,g,b,1), table->target, fz.hue, fz.saturation, fz.value);
+	return (a0 == 0 && a1 == 1)? 0 : a0+1;
+}
+
+/*	exact table miss: works out the color and saves it for next time
+ *	threads racing on the same color both store the same value, so no lock */
+unsigned char fillKeyEntry(KeyTable* table, pxRGBA px) {
+	uint16_t entry = keyEntry(table, px.red, px.green, px.blue)+1;
+	__atomic_store_n(&table->exact[(px.red<<16)|(px.green<<8)|px.blue], entry, __ATOMIC_RELAXED);
+	return (entry == 1)? px.alpha : (unsigned char)(entry-2);
+}
+
+/* grid lookup: trilinear between the 8 samples around px, in integer steps of 1/KEYLUT_GRID_STEP^3 */
+unsigned char gridKeyAlpha(const KeyTable* table, pxRGBA px) {
+	const int step = KEYLUT_GRID_STEP;
+	const int nodes = KEYLUT_GRID_NODES;
+	int ri = clampInt(px.red/step, 0, nodes-2), rf = px.red - ri*step;
+	int gi = clampInt(px.green/step, 0, nodes-2), gf = px.green - gi*step;
+	int bi = clampInt(px.blue/step, 0, nodes-2), bf = px.blue - bi*step;
+	//weights along each axis, near & far sample
+	int wr[2] = {step-rf, rf};
+	int wg[2] = {step-gf, gf};
+	int wb[2] = {step-bf, bf};
+	const int16_t* base = &table->grid[(ri*nodes + gi)*nodes + bi];
+	int total = 0;
+	for (int dr=0; dr<2; dr++) {
+		for (int dg=0; dg<2; dg++) {
+			const int16_t* line = base + (dr*nodes + dg)*nodes;
+			int near = (line[0] < 0)? px.alpha : line[0];
+			int far = (line[1] < 0)? px.alpha : line[1];
+			total += wr[dr]*wg[dg]*(wb[0]*near + wb[1]*far);
+		}
+	}
+	const int whole = step*step*step;
+	return (unsigned char)((total + whole/2) / whole);
+}
+
+/** TABLE CACHE **/
+static void discardKeyTable(KeyTable* table) {
+	free(table->exact);
+	delete[] table->grid;
+	delete table;
+}
+
+static KeyTable* buildKeyTable(KeyLutMode mode, pxHSV target, pxHSV fuzz) {
+	KeyTable* table = new KeyTable;
+	table->mode = mode;
+	table->target = target;
+	table->fuzz = fuzz;
+	table->exact = nullptr;
+	table->grid = nullptr;
+	if (mode == KEYLUT_EXACT) {
+		//calloc so the OS only hands over pages for colors that actually get used
+		table->exact = (uint16_t*)calloc((size_t)1<<24, sizeof(uint16_t));
+	}
+	else if (mode == KEYLUT_GRID) {
+		const int nodes = KEYLUT_GRID_NODES;
+		table->grid = new int16_t[nodes*nodes*nodes];
+		for (int r=0; r<nodes; r++) {
+			for (int g=0; g<nodes; g++) {
+				for (int b=0; b<nodes; b++) {
+					int entry = keyEntry(table, r*KEYLUT_GRID_STEP, g*KEYLUT_GRID_STEP, b*KEYLUT_GRID_STEP);
+					table->grid[(r*nodes + g)*nodes + b] = entry-1;
+				}
+			}
+		}
+	}
+	return table;
+}
+
+static bool sameHSV(pxHSV a, pxHSV b) {
+	return a.hue == b.hue && a.saturation == b.saturation && a.value == b.value;
+}
+
+/*	table for keying with this target & fuzz in the current mode
+ *	the last KEYLUT_CACHE_TABLES tables are kept, so keying a batch of frames
+ *	with the same settings only builds one. safe to call from several threads */
+shared_ptr<KeyTable> keyTableFor(pxHSV target, double huefuzz, double satfuzz, double valfuzz) {
+	static mutex cacheLock;
+	static vector<shared_ptr<KeyTable>> cache; //most recently used last
+	pxHSV fuzz = linkHSV(huefuzz, satfuzz, valfuzz);
+	KeyLutMode mode = keyLutMode;
+
+	lock_guard<mutex> lock(cacheLock);
+	for (size_t i=0; i<cache.size(); i++) {
+		shared_ptr<KeyTable> table = cache[i];
+		if (table->mode == mode && sameHSV(table->target, target) && sameHSV(table->fuzz, fuzz)) {
+			cache.erase(cache.begin()+i);
+			cache.push_back(table);
+			return table;
+		}
+	}
+	shared_ptr<KeyTable> table(buildKeyTable(mode, target, fuzz), discardKeyTable);
+	if (mode == KEYLUT_OFF) {
+		return table; //nothing worth keeping
+	}
+	if (cache.size() >= KEYLUT_CACHE_TABLES) {
+		cache.erase(cache.begin());
+	}
+	cache.push_back(table);
+	return table;
+}
@@ -0,0 +1,52 @@
+#ifndef GLOIIO_OB_KEY_H
+#define GLOIIO_OB_KEY_H
+#include "gloiioFuncs.h"
+#include <cstdint>
+#include <memory>
+
+//environment variable that picks the key table (exact, grid, off)
+#define KEYLUT_ENV "GLOIIO_KEYLUT"
+//grid mode samples every this many levels per channel (has to divide 255)
+#define KEYLUT_GRID_STEP 5
+#define KEYLUT_GRID_NODES (255/KEYLUT_GRID_STEP+1)
+//how many target/fuzz combinations keep their tables around
+#define KEYLUT_CACHE_TABLES 2
+
+//how chromaKey turns a color into an alpha
+typedef enum key_lut_mode_t {
+	KEYLUT_OFF, //HSV math for every pixel
+	KEYLUT_EXACT, //full 24 bit RGB table, each color worked out the first time it shows up
+	KEYLUT_GRID //KEYLUT_GRID_NODES^3 samples, trilinear in between (close, not exact)
+} KeyLutMode;
+
+/*	RGB -> alpha table for one target & fuzz
+ *	exact entries are 0 until looked up, then 1 for "keep the pixel's alpha" or alpha+2
+ *	grid entries are -1 for "keep the pixel's alpha" or the alpha */
+typedef struct key_table_t {
+	KeyLutMode mode;
+	pxHSV target;
+	pxHSV fuzz;
+	uint16_t* exact;
+	int16_t* grid;
+} KeyTable;
+
+void setKeyLutMode(KeyLutMode);
+KeyLutMode getKeyLutMode();
+KeyLutMode keyLutModeFromName(string);
+unsigned char keyAlpha(pxRGBA, pxHSV, double, double, double);
+shared_ptr<KeyTable> keyTableFor(pxHSV, double, double, double);
+unsigned char fillKeyEntry(KeyTable*, pxRGBA);
+unsigned char gridKeyAlpha(const KeyTable*, pxRGBA);
+
+/* alpha chromaKey gives px, from the table */
+static inline unsigned char keyTableAlpha(KeyTable* table, pxRGBA px) {
+	if (table->mode == KEYLUT_EXACT) {
+		uint16_t entry = __atomic_load_n(&table->exact[(px.red<<16)|(px.green<<8)|px.blue], __ATOMIC_RELAXED);
+		if (entry == 0) { return fillKeyEntry(table, px); }
+		return (entry == 1)? px.alpha : (unsigned char)(entry-2);
+	}
+	if (table->mode == KEYLUT_GRID) { return gridKeyAlpha(table, px); }
+	return keyAlpha(px, table->target, table->fuzz.hue, table->fuzz.saturation, table->fuzz.value);
+}
+
+#endif
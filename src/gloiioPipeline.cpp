@@ -0,0 +1,169 @@
+#include "gloiioPipeline.h"
+#include "gloiioPool.h"
+#include <cstring>
+#include <sstream>
+
+/** STAGES **/
+PipelineStage pointStage(string name, function<void(ImageRGBA&,int)> op) {
+	PipelineStage stage;
+	stage.kind = STAGE_POINT;
+	stage.name = name;
+	stage.point = op;
+	stage.filt.kernel = nullptr;
+	return stage;
+}
+
+/* the stream so far goes over background (same size as the source) */
+PipelineStage overStage(ImageRGBA background) {
+	PipelineStage stage = pointStage("over", nullptr);
+	stage.kind = STAGE_BLEND;
+	stage.layer = std::move(background);
+	return stage;
+}
+
+PipelineStage convolveStage(RawFilter filt, EdgeMode edge) {
+	PipelineStage stage = pointStage("convolve", nullptr);
+	stage.kind = STAGE_NEIGHBORHOOD;
+	stage.filt = filt;
+	stage.edge = edge;
+	return stage;
+}
+
+/* splits "a,b,c" into {"a","b","c"} */
+static vector<string> splitArgs(string list) {
+	vector<string> parts;
+	stringstream ss(list);
+	string part;
+	while (getline(ss, part, ',')) {
+		parts.push_back(part);
+	}
+	return parts;
+}
+
+/*	builds a stage from its command line description:
+ *	invert | noise:denom | key:h,s,v(,fuzzh,fuzzs,fuzzv) | over:background | convolve:filter.filt(,edge)
+ *	reads any files it names, free them with discardStage
+ *	THROWS EXCEPTION on an unknown stage or IO fail */
+PipelineStage parseStage(string desc) {
+	size_t colon = desc.find(':');
+	string op = desc.substr(0, colon);
+	vector<string> args = (colon == string::npos)? vector<string>() : splitArgs(desc.substr(colon+1));
+
+	if (op == "invert") {
+		return pointStage(desc, [](ImageRGBA& band, int) { invert(band); });
+	}
+	if (op == "noise" && args.size() >= 1) {
+		int denom = stoi(args[0],nullptr);
+		return pointStage(desc, [denom](ImageRGBA& band, int row0) { noisify(band, denom, row0); });
+	}
+	if (op == "key" && args.size() >= 3) {
+		pxHSV target = linkHSV(stod(args[0],nullptr),stod(args[1],nullptr),stod(args[2],nullptr));
+		pxHSV fuzz = linkHSV(20.0, 0.2, 0.2); //same fallback as alphamask
+		if (args.size() >= 6) {
+			fuzz = linkHSV(stod(args[3],nullptr),stod(args[4],nullptr),stod(args[5],nullptr));
+		}
+		return pointStage(desc, [target,fuzz](ImageRGBA& band, int) {
+			chromaKey(band, target, fuzz.hue, fuzz.saturation, fuzz.value);
+		});
+	}
+	if (op == "over" && args.size() >= 1) {
+		PipelineStage stage = overStage(readImage(args[0]));
+		stage.name = desc;
+		return stage;
+	}
+	if (op == "convolve" && args.size() >= 1) {
+		EdgeMode edge = (args.size() >= 2)? edgeModeFromName(args[1]) : EDGE_CENTER;
+		PipelineStage stage = convolveStage(readFilter(args[0]), edge);
+		stage.name = desc;
+		return stage;
+	}
+	cerr << "don't know how to do pipeline stage " << desc << endl;
+	throw runtime_error("bad pipeline stage");
+}
+
+/* frees whatever parseStage read in for a stage */
+void discardStage(PipelineStage& stage) {
+	if (stage.kind == STAGE_BLEND) { discardImage(stage.layer); }
+	if (stage.kind == STAGE_NEIGHBORHOOD) { discardRawFilter(stage.filt); }
+}
+
+/** EXECUTION **/
+/*	rows y0~y1 of what the first k stages make out of source, as a new image
+ *	point & blend stages work on the same rows they're asked for, so a run of
+ *	them all happens on one band while it's in cache. a neighborhood stage
+ *	asks for its filter's reach of extra rows on both sides, filters the lot
+ *	and keeps the middle: the extra rows' own results are wrong (they see the
+ *	band edge as the image edge) but every kept row's window is all real rows.
+ *	bands come out of the pixel pool, so after the first few they cost no mallocs */
+static ImageRGBA produceRows(const vector<PipelineStage>& stages, int k, const ImageRGBA& source, int y0, int y1) {
+	int height = source.spec.height;
+	if (k == 0) {
+		return cloneImage(source.view(y0, y1));
+	}
+
+	const PipelineStage& stage = stages[k-1];
+	switch (stage.kind) {
+		case STAGE_POINT: {
+			ImageRGBA band = produceRows(stages, k-1, source, y0, y1);
+			stage.point(band, y0);
+			return band;
+		}
+		case STAGE_BLEND: {
+			ImageRGBA band = produceRows(stages, k-1, source, y0, y1);
+			ImageRGBA under = cloneImage(stage.layer.view(y0, y1));
+			compose(band, under);
+			return under;
+		}
+		default: {
+			int half = stage.filt.size/2;
+			int ey0 = (stage.edge == EDGE_WRAP || y0-half < 0)? 0 : y0-half;
+			int ey1 = (stage.edge == EDGE_WRAP || y1+half > height)? height : y1+half;
+			ImageRGBA wide = produceRows(stages, k-1, source, ey0, ey1);
+			convolve(stage.filt, wide, stage.edge);
+			return cloneImage(wide.view(y0-ey0, y1-ey0));
+		}
+	}
+}
+
+/*	runs source through every stage in order and returns the result as a new image
+ *	(source is left alone). the image is done in bands of rows sized to stay in
+ *	cache, spread over the thread pool, so the whole chain makes one pass over
+ *	memory instead of one per stage
+ *	THROWS EXCEPTION if a blend layer isn't the same size as source */
+ImageRGBA runPipeline(const vector<PipelineStage>& stages, const ImageRGBA& source) {
+	int width = source.spec.width;
+	int height = source.spec.height;
+
+	//total extra rows a band drags in through every neighborhood stage
+	int reach = 0;
+	bool wholeImage = false;
+	for (const PipelineStage& stage : stages) {
+		if (stage.kind == STAGE_BLEND && (stage.layer.spec.width != width || stage.layer.spec.height != height)) {
+			cerr << "pipeline layer is " << stage.layer.spec.width << "x" << stage.layer.spec.height
+				<< " but the image is " << width << "x" << height << "!" << endl;
+			throw runtime_error("pipeline layer size mismatch");
+		}
+		if (stage.kind == STAGE_NEIGHBORHOOD) {
+			reach += stage.filt.size/2;
+			wholeImage = wholeImage || stage.edge == EDGE_WRAP; //needs the far side of the image
+		}
+	}
+
+	//bands big enough that the extra rows stay a small fraction of the work
+	int band = PIPELINE_BAND_BYTES/(width*(int)sizeof(pxRGBA));
+	if (band < 4*reach) { band = 4*reach; }
+	if (band < 1) { band = 1; }
+	if (wholeImage || band > height) { band = height; }
+	int bands = (height+band-1)/band;
+
+	ImageRGBA result(source.spec);
+	parallelRows(0, bands, [&](int b0, int b1) {
+		for (int b=b0; b<b1; b++) {
+			int y0 = b*band;
+			int y1 = (y0+band < height)? y0+band : height;
+			ImageRGBA rows = produceRows(stages, stages.size(), source, y0, y1);
+			memcpy(&result.pixels[contigIndex(y0,0,width)], rows.pixels, (size_t)(y1-y0)*width*sizeof(pxRGBA));
+		}
+	}, 1);
+	return result;
+}
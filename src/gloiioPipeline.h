@@ -0,0 +1,34 @@
+#ifndef GLOIIO_OB_PIPELINE_H
+#define GLOIIO_OB_PIPELINE_H
+#include "gloiioFuncs.h"
+#include <vector>
+#include <functional>
+
+//pixel bytes per band the pipeline aims for, so a band and its intermediates stay in L2
+#define PIPELINE_BAND_BYTES (256*1024)
+
+//what a stage needs to see of the image to compute one pixel
+typedef enum stage_kind_t {
+	STAGE_POINT, //just that pixel (invert, chromaKey, noisify)
+	STAGE_BLEND, //that pixel and the same pixel of another image (compose)
+	STAGE_NEIGHBORHOOD //a window around that pixel (convolve)
+} StageKind;
+
+//one operation in a pipeline, only the fields for its kind are used
+typedef struct pipeline_stage_t {
+	StageKind kind;
+	string name;
+	function<void(ImageRGBA&,int)> point; //modifies a band in place, gets the band's first row
+	ImageRGBA layer; //background the stream is composed over
+	RawFilter filt;
+	EdgeMode edge;
+} PipelineStage;
+
+PipelineStage pointStage(string, function<void(ImageRGBA&,int)>);
+PipelineStage overStage(ImageRGBA);
+PipelineStage convolveStage(RawFilter, EdgeMode);
+PipelineStage parseStage(string);
+void discardStage(PipelineStage&);
+ImageRGBA runPipeline(const vector<PipelineStage>&, const ImageRGBA&);
+
+#endif
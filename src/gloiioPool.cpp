@@ -0,0 +1,167 @@
+#include "gloiioPool.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <cstdlib>
+
+using namespace std;
+
+/** WORK POOL **/
+/*	one call to parallelRows, split into bands that anyone can claim
+ *	the thread that made the call works on its own job too, so calling
+ *	parallelRows from inside a band (or from several threads) can't deadlock */
+struct RowJob {
+	function<void(int,int)> body;
+	int begin, end, band;
+	int bands;
+	atomic<int> next{0}; //next band to hand out
+	atomic<int> left{0}; //bands not finished yet
+	mutex doneLock;
+	condition_variable doneCond;
+};
+
+/* runs bands of job until there are none left to claim
+ * returns false if nothing was claimed */
+static bool runBands(RowJob* job) {
+	bool ran = false;
+	int b;
+	while ((b = job->next.fetch_add(1)) < job->bands) {
+		int y0 = job->begin + b*job->band;
+		int y1 = (y0+job->band < job->end)? y0+job->band : job->end;
+		job->body(y0, y1);
+		ran = true;
+		if (job->left.fetch_sub(1) == 1) {
+			lock_guard<mutex> lk(job->doneLock);
+			job->doneCond.notify_all();
+		}
+	}
+	return ran;
+}
+
+/*	persistent set of worker threads, created on first use and kept for the
+ *	life of the program so every convolve doesn't pay for thread startup */
+class WorkPool {
+public:
+	WorkPool() { start(defaultCount()); }
+	~WorkPool() { stop(); }
+
+	int count() { return nthreads; }
+
+	/* restarts the pool with a new thread count (0 = default) */
+	void resize(int n) {
+		if (n <= 0) { n = defaultCount(); }
+		if (n == nthreads) { return; }
+		stop();
+		start(n);
+	}
+
+	void run(shared_ptr<RowJob> job) {
+		{
+			lock_guard<mutex> lk(queueLock);
+			queue.push_back(job);
+		}
+		queueCond.notify_all();
+		runBands(job.get());
+		//wait for bands other threads are still chewing on
+		unique_lock<mutex> lk(job->doneLock);
+		job->doneCond.wait(lk, [&]{ return job->left.load() == 0; });
+	}
+
+private:
+	int nthreads = 0;
+	bool quitting = false;
+	vector<thread> workers;
+	deque<shared_ptr<RowJob>> queue;
+	mutex queueLock;
+	condition_variable queueCond;
+
+	/* GLOIIO_THREADS if set, otherwise one thread per core */
+	static int defaultCount() {
+		const char* env = getenv(THREADS_ENV);
+		if (env && atoi(env) > 0) { return atoi(env); }
+		int hw = thread::hardware_concurrency();
+		return (hw > 0)? hw : 1;
+	}
+
+	void start(int n) {
+		nthreads = n;
+		quitting = false;
+		//the calling thread is always one of the n
+		for (int i=1; i<n; i++) {
+			workers.emplace_back([this]{ workLoop(); });
+		}
+	}
+
+	void stop() {
+		{
+			lock_guard<mutex> lk(queueLock);
+			quitting = true;
+		}
+		queueCond.notify_all();
+		for (thread& t : workers) { t.join(); }
+		workers.clear();
+	}
+
+	void workLoop() {
+		while (true) {
+			shared_ptr<RowJob> job;
+			{
+				unique_lock<mutex> lk(queueLock);
+				queueCond.wait(lk, [&]{ return quitting || !queue.empty(); });
+				if (quitting) { return; }
+				job = queue.front();
+				//fully handed out jobs don't need to sit in the queue
+				if (job->next.load() >= job->bands) {
+					queue.pop_front();
+					continue;
+				}
+			}
+			runBands(job.get());
+		}
+	}
+};
+
+static WorkPool& pool() {
+	static WorkPool p;
+	return p;
+}
+
+/*	sets the number of threads used by parallelRows
+ *	0 goes back to the default (GLOIIO_THREADS or hardware_concurrency) */
+void setThreadCount(int n) {
+	pool().resize(n);
+}
+
+int getThreadCount() {
+	return pool().count();
+}
+
+/*	calls body(y0,y1) over bands covering rows begin~end, spread over the pool
+ *	bands are sized to give each thread a few of them for load balancing,
+ *	but never fewer than grain rows (use 1 when each "row" is already big work).
+ *	body must only write rows inside its own band */
+void parallelRows(int begin, int end, function<void(int,int)> body, int grain) {
+	int rows = end-begin;
+	if (rows <= 0) { return; }
+	if (grain < 1) { grain = 1; }
+	int nthreads = getThreadCount();
+	if (nthreads <= 1 || rows <= grain) {
+		body(begin, end);
+		return;
+	}
+	int band = rows/(nthreads*4);
+	if (band < grain) { band = grain; }
+
+	shared_ptr<RowJob> job = make_shared<RowJob>();
+	job->body = body;
+	job->begin = begin;
+	job->end = end;
+	job->band = band;
+	job->bands = (rows+band-1)/band;
+	job->left = job->bands;
+	pool().run(job);
+}
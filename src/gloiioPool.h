@@ -0,0 +1,14 @@
+#ifndef GLOIIO_OB_POOL_H
+#define GLOIIO_OB_POOL_H
+#include <functional>
+
+//environment variable that overrides the worker count (same as setThreadCount)
+#define THREADS_ENV "GLOIIO_THREADS"
+//default minimum rows per band, tiny bands cost more to hand out than to run
+#define MIN_BAND_ROWS 8
+
+void setThreadCount(int);
+int getThreadCount();
+void parallelRows(int, int, std::function<void(int,int)>, int grain = MIN_BAND_ROWS);
+
+#endif
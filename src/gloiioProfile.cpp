@@ -0,0 +1,159 @@
+#include "gloiioProfile.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace std;
+
+/** PROFILING **/
+/*	every timed call goes in a log kept by the thread that made it, so recording
+ *	never takes a lock; the logs are only gathered up at exit. logs stay around
+ *	after their thread is gone (batch workers come and go) */
+typedef struct profile_event_t {
+	const char* name;
+	int64_t start, dur; //ns since profiling started
+	uint64_t pixels, bytes;
+} ProfileEvent;
+
+typedef struct thread_log_t {
+	int tid; //small number in the order threads first recorded something (0 is usually main)
+	vector<ProfileEvent> events;
+} ThreadLog;
+
+atomic<int> profileState{-1};
+static once_flag profileOnce;
+static mutex logsLock;
+static vector<ThreadLog*> logs;
+static string tracePath;
+static chrono::steady_clock::time_point epoch;
+static thread_local ThreadLog* threadLog = nullptr;
+
+static void profileExit();
+
+/* looks at GLOIIO_PROFILE & GLOIIO_TRACE once, and sets up the report at exit if either is set */
+void initProfile() {
+	call_once(profileOnce, [] {
+		const char* env = getenv(PROFILE_ENV);
+		const char* trace = getenv(PROFILE_TRACE_ENV);
+		bool on = env && (string(env) == "on" || string(env) == "1");
+		if (trace && *trace) {
+			tracePath = string(trace);
+			on = true;
+		}
+		if (on) {
+			epoch = chrono::steady_clock::now();
+			atexit(profileExit);
+		}
+		profileState = on? 1 : 0;
+	});
+}
+
+/* ns since profiling started */
+int64_t profileNow() {
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now()-epoch).count();
+}
+
+/* adds one call to the calling thread's log (ProfileScope does this for you) */
+void profileRecord(const char* name, int64_t start, int64_t dur, uint64_t pixels, uint64_t bytes) {
+	if (!threadLog) {
+		threadLog = new ThreadLog;
+		lock_guard<mutex> lk(logsLock);
+		threadLog->tid = logs.size();
+		logs.push_back(threadLog);
+	}
+	threadLog->events.push_back({name, start, dur, pixels, bytes});
+}
+
+/*	per name: calls, total/mean/max time, pixels & bytes with their rates, and how
+ *	many threads it ran on. sorted by total time, nested calls count in both */
+static void printSummary() {
+	typedef struct profile_total_t {
+		uint64_t calls = 0, pixels = 0, bytes = 0;
+		int64_t total = 0, longest = 0;
+		set<int> threads;
+	} ProfileTotal;
+	map<string, ProfileTotal> totals;
+	for (ThreadLog* log : logs) {
+		for (ProfileEvent& e : log->events) {
+			ProfileTotal& t = totals[e.name];
+			t.calls++;
+			t.total += e.dur;
+			t.longest = max(t.longest, e.dur);
+			t.pixels += e.pixels;
+			t.bytes += e.bytes;
+			t.threads.insert(log->tid);
+		}
+	}
+	vector<pair<string, ProfileTotal>> sorted(totals.begin(), totals.end());
+	sort(sorted.begin(), sorted.end(), [](const pair<string, ProfileTotal>& a, const pair<string, ProfileTotal>& b) {
+		return a.second.total > b.second.total;
+	});
+
+	cerr << endl << "profile (" << logs.size() << " threads):" << endl;
+	cerr << left << setw(24) << "name" << right << setw(8) << "calls" << setw(12) << "total ms" << setw(10) << "mean ms"
+		<< setw(10) << "max ms" << setw(10) << "MP" << setw(10) << "MP/s" << setw(10) << "MB" << setw(10) << "GB/s"
+		<< setw(8) << "threads" << endl;
+	cerr << fixed << setprecision(2);
+	for (auto& entry : sorted) {
+		ProfileTotal& t = entry.second;
+		double ms = t.total/1e6;
+		double secs = (t.total > 0)? t.total/1e9 : 1e-9;
+		cerr << left << setw(24) << entry.first << right << setw(8) << t.calls << setw(12) << ms << setw(10) << ms/t.calls
+			<< setw(10) << t.longest/1e6 << setw(10) << t.pixels/1e6 << setw(10) << t.pixels/1e6/secs
+			<< setw(10) << t.bytes/1e6 << setw(10) << t.bytes/1e9/secs << setw(8) << t.threads.size() << endl;
+	}
+}
+
+/* name with quotes & backslashes escaped for a JSON string */
+static string jsonString(const char* name) {
+	string out = "\"";
+	for (const char* c = name; *c; c++) {
+		if (*c == '"' || *c == '\\') { out += '\\'; }
+		out += *c;
+	}
+	return out + "\"";
+}
+
+/*	every call as a Chrome trace event ("X" events, times in us), one per line;
+ *	open it in chrome://tracing or ui.perfetto.dev to see each thread's timeline */
+static void writeTrace() {
+	ofstream out(tracePath);
+	if (!out) {
+		cerr << "could not open trace file " << tracePath << endl;
+		return;
+	}
+	int pid = getpid();
+	out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << endl;
+	out << fixed << setprecision(3);
+	bool first = true;
+	for (ThreadLog* log : logs) {
+		out << (first? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << pid << ", \"tid\": " << log->tid
+			<< ", \"args\": {\"name\": \"thread " << log->tid << "\"}}";
+		first = false;
+		for (ProfileEvent& e : log->events) {
+			out << ",\n{\"name\": " << jsonString(e.name) << ", \"cat\": \"gloiio\", \"ph\": \"X\", \"ts\": " << e.start/1e3
+				<< ", \"dur\": " << e.dur/1e3 << ", \"pid\": " << pid << ", \"tid\": " << log->tid
+				<< ", \"args\": {\"pixels\": " << e.pixels << ", \"bytes\": " << e.bytes << "}}";
+		}
+	}
+	out << endl << "]}" << endl;
+	cerr << "wrote trace to " << tracePath << endl;
+}
+
+/* the report, when the program exits */
+static void profileExit() {
+	lock_guard<mutex> lk(logsLock);
+	printSummary();
+	if (!tracePath.empty()) {
+		writeTrace();
+	}
+}
@@ -0,0 +1,53 @@
+#ifndef GLOIIO_OB_PROFILE_H
+#define GLOIIO_OB_PROFILE_H
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+
+//environment variable that turns profiling on (on|1), a summary goes to stderr on exit
+#define PROFILE_ENV "GLOIIO_PROFILE"
+//environment variable naming a Chrome trace file to write on exit (turns profiling on too)
+#define PROFILE_TRACE_ENV "GLOIIO_TRACE"
+
+//-1 = environment not looked at yet, 0 = off, 1 = on
+extern std::atomic<int> profileState;
+void initProfile();
+int64_t profileNow();
+void profileRecord(const char*, int64_t, int64_t, uint64_t, uint64_t);
+
+/* true if calls should be timed (checks the environment the first time only) */
+inline bool profiling() {
+	int state = profileState.load(std::memory_order_acquire);
+	if (state < 0) {
+		initProfile();
+		state = profileState.load();
+	}
+	return state > 0;
+}
+
+//times the block it's declared in as one call of name, along with the pixels it
+//touched and the bytes it read + wrote. name has to be a string literal (it's
+//kept as is). when profiling is off this costs one branch
+class ProfileScope {
+public:
+	ProfileScope(const char* n, uint64_t px = 0, uint64_t b = 0) : name(n), pixels(px), bytes(b) {
+		start = profiling()? profileNow() : -1;
+	}
+	void add(uint64_t px, uint64_t b) { pixels += px; bytes += b; } //for counts only known partway through
+	~ProfileScope() {
+		if (start >= 0) { profileRecord(name, start, profileNow()-start, pixels, bytes); }
+	}
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+private:
+	const char* name;
+	uint64_t pixels, bytes;
+	int64_t start; //ns, -1 if not profiling
+};
+
+#define PROFILE_JOIN2(a,b) a##b
+#define PROFILE_JOIN(a,b) PROFILE_JOIN2(a,b)
+//PROFILE_SCOPE("name", pixels, bytes): times the rest of the enclosing block
+#define PROFILE_SCOPE(...) ProfileScope PROFILE_JOIN(profileScope, __LINE__)(__VA_ARGS__)
+
+#endif
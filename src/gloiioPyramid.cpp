@@ -0,0 +1,89 @@
+#include "gloiioPyramid.h"
+#include "gloiioPool.h"
+
+/** PYRAMID **/
+/* pyramid over image, nothing but level 0 exists yet
+ * the image has to outlive the pyramid (and not change size) */
+ImagePyramid makePyramid(const ImageRGBA& image) {
+	ImagePyramid pyr;
+	pyr.base = image.view();
+	return pyr;
+}
+
+/* how many levels there can be, counting the image itself (the last one is 1x1) */
+int pyramidDepth(const ImagePyramid& pyr) {
+	int depth = 1;
+	for (int w=pyr.base.spec.width, h=pyr.base.spec.height; w > 1 || h > 1; w=(w+1)/2, h=(h+1)/2) {
+		depth++;
+	}
+	return depth;
+}
+
+/*	level k of the pyramid (0 is the image itself), made if it doesn't exist yet
+ *	its rows can be out of date, pyramidRefresh the ones you're going to look at */
+const ImageRGBA& pyramidLevel(ImagePyramid& pyr, int k) {
+	if (k <= 0) { return pyr.base; }
+	while ((int)pyr.levels.size() < k) {
+		const ImageRGBA& below = pyramidLevel(pyr, pyr.levels.size());
+		int w = (below.spec.width+1)/2;
+		int h = (below.spec.height+1)/2;
+		pyr.levels.push_back(ImageRGBA(ImageSpec(w, h, 4, TypeDesc::UINT8)));
+		pyr.dirty.push_back(vector<char>(h, 1));
+	}
+	return pyr.levels[k-1];
+}
+
+/* row y of level k as the average of each 2x2 block under it (odd edges repeat the last pixel) */
+static void shrinkRow(const ImageRGBA& below, ImageRGBA& level, int y) {
+	int bw = below.spec.width, bh = below.spec.height;
+	int w = level.spec.width;
+	const pxRGBA* row0 = &below.pixels[contigIndex(2*y,0,bw)];
+	const pxRGBA* row1 = &below.pixels[contigIndex((2*y+1 < bh)? 2*y+1 : 2*y,0,bw)];
+	pxRGBA* out = &level.pixels[contigIndex(y,0,w)];
+	for (int x=0; x<w; x++) {
+		int x0 = 2*x;
+		int x1 = (x0+1 < bw)? x0+1 : x0;
+		out[x].red = (row0[x0].red + row0[x1].red + row1[x0].red + row1[x1].red + 2) >> 2;
+		out[x].green = (row0[x0].green + row0[x1].green + row1[x0].green + row1[x1].green + 2) >> 2;
+		out[x].blue = (row0[x0].blue + row0[x1].blue + row1[x0].blue + row1[x1].blue + 2) >> 2;
+		out[x].alpha = (row0[x0].alpha + row0[x1].alpha + row1[x0].alpha + row1[x1].alpha + 2) >> 2;
+	}
+}
+
+/*	brings rows y0~y1 of level k up to date with the image, redoing just the rows
+ *	(and the rows under them on every level down) that were marked dirty */
+void pyramidRefresh(ImagePyramid& pyr, int k, int y0, int y1) {
+	if (k <= 0) { return; }
+	pyramidLevel(pyr, k); //make it if it isn't there yet
+	ImageRGBA& level = pyr.levels[k-1];
+	vector<char>& dirty = pyr.dirty[k-1];
+	y0 = clampInt(y0, 0, level.spec.height);
+	y1 = clampInt(y1, 0, level.spec.height);
+	while (y0 < y1 && !dirty[y0]) { y0++; }
+	while (y1 > y0 && !dirty[y1-1]) { y1--; }
+	if (y0 >= y1) { return; }
+
+	pyramidRefresh(pyr, k-1, 2*y0, 2*y1);
+	const ImageRGBA& below = pyramidLevel(pyr, k-1);
+	parallelRows(y0, y1, [&](int r0, int r1) {
+		for (int y=r0; y<r1; y++) {
+			if (dirty[y]) {
+				shrinkRow(below, level, y);
+				dirty[y] = 0;
+			}
+		}
+	});
+}
+
+/* rows y0~y1 of the image changed, so everything above them on every level is out of date */
+void pyramidDirtyRows(ImagePyramid& pyr, int y0, int y1) {
+	for (size_t k=1; k<=pyr.levels.size() && y0 < y1; k++) {
+		y0 = y0/2;
+		y1 = (y1+1)/2;
+		vector<char>& dirty = pyr.dirty[k-1];
+		int h = dirty.size();
+		for (int y=clampInt(y0,0,h); y<clampInt(y1,0,h); y++) {
+			dirty[y] = 1;
+		}
+	}
+}
@@ -0,0 +1,21 @@
+#ifndef GLOIIO_OB_PYRAMID_H
+#define GLOIIO_OB_PYRAMID_H
+#include "gloiioFuncs.h"
+#include <vector>
+
+//an image at every power of two size down to a single pixel, each level half the
+//one below it (2x2 averages). levels are only made, and out of date rows only
+//redone, when somebody asks for them, so a pyramid nobody zooms out on costs nothing
+typedef struct image_pyramid_t {
+	ImageRGBA base; //level 0, a view of the image itself (not a copy)
+	vector<ImageRGBA> levels; //level k at levels[k-1], made the first time it's asked for
+	vector<vector<char>> dirty; //same indexes: rows that don't match the level below anymore
+} ImagePyramid;
+
+ImagePyramid makePyramid(const ImageRGBA&);
+int pyramidDepth(const ImagePyramid&);
+const ImageRGBA& pyramidLevel(ImagePyramid&, int);
+void pyramidRefresh(ImagePyramid&, int, int, int);
+void pyramidDirtyRows(ImagePyramid&, int, int);
+
+#endif
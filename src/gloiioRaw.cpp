@@ -0,0 +1,207 @@
+#include "gloiioRaw.h"
+#include "gloiioBatch.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <cerrno>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+
+using namespace std;
+
+/** RAW CACHE **/
+/*	decoding a big PNG takes far longer than reading the same pixels straight off
+ *	the disk, so decoded images can be kept around as cache files in the same
+ *	layout as an ImageRGBA. those get mmap'd instead of read: the image points
+ *	right into the mapping and pages come in as they're touched, and since it's a
+ *	private mapping edits only ever change the program's own copy, never the file */
+static_assert(sizeof(RawHeader) == 64, "RawHeader must be 64 bytes");
+
+//nanoseconds part of a stat's modification time (a rewrite within the same second still shows)
+#ifdef __APPLE__
+	#define MTIME_NSEC(st) ((st).st_mtimespec.tv_nsec)
+#else
+	#define MTIME_NSEC(st) ((st).st_mtim.tv_nsec)
+#endif
+
+//set by --rawcache-fill, adds to the cache no matter what the environment says
+static bool fillMode = false;
+
+/* what GLOIIO_RAWCACHE says: -1 = off, 1 = on, 0 = unset (or anything else) */
+static int rawCacheSetting() {
+	const char* env = getenv(RAW_CACHE_ENV);
+	if (!env) { return 0; }
+	string val = string(env);
+	if (val == "off" || val == "0") { return -1; }
+	if (val == "on" || val == "1") { return 1; }
+	return 0;
+}
+
+/* true if images that get decoded should be added to the cache */
+bool rawCacheAdds() {
+	return fillMode || rawCacheSetting() > 0;
+}
+
+/* the directory cache files go in (not made yet, see makeDirs) */
+static string cacheDir() {
+	const char* env = getenv(RAW_CACHE_DIR_ENV);
+	if (env && *env) { return string(env); }
+	env = getenv("XDG_CACHE_HOME");
+	if (env && *env) { return string(env) + "/gloiio"; }
+	env = getenv("HOME");
+	if (env && *env) { return string(env) + "/.cache/gloiio"; }
+	return "/tmp/gloiio";
+}
+
+/* mkdir -p */
+static bool makeDirs(string dir) {
+	for (size_t slash=dir.find('/',1); ; slash=dir.find('/',slash+1)) {
+		string part = dir.substr(0, slash);
+		if (mkdir(part.c_str(), 0755) != 0 && errno != EEXIST) { return false; }
+		if (slash == string::npos) { return true; }
+	}
+}
+
+/*	64 bit FNV-1a, spelled out so cache file names don't change with the
+ *	standard library (std::hash is whatever the implementation feels like) */
+static uint64_t fnv1a(const string& text) {
+	uint64_t h = 14695981039346656037ULL;
+	for (unsigned char c : text) {
+		h ^= c;
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+/*	the cache file for a source image: named after a hash of its full path,
+ *	so the same file reached through different relative paths shares it */
+static string cacheFile(string source) {
+	char full[PATH_MAX];
+	if (realpath(source.c_str(), full)) {
+		source = string(full);
+	}
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx", (unsigned long long)fnv1a(source));
+	return cacheDir() + "/" + name + RAW_EXT;
+}
+
+/*	maps source's cache file into image if there is one and it's still good
+ *	(same modification time, to the nanosecond, & size as the source now). returns false if not */
+bool mapRawCached(string source, ImageRGBA& image) {
+	if (rawCacheSetting() < 0) { return false; }
+	struct stat src;
+	if (stat(source.c_str(), &src) != 0) { return false; }
+	string path = cacheFile(source);
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) { return false; }
+
+	RawHeader head;
+	struct stat cached;
+	bool good = read(fd, &head, sizeof(head)) == (ssize_t)sizeof(head)
+		&& memcmp(head.magic, RAW_MAGIC, 8) == 0 && head.version == RAW_VERSION
+		&& head.sourceMtime == (int64_t)src.st_mtime && head.sourceMtimeNsec == (int64_t)MTIME_NSEC(src)
+		&& head.sourceSize == (int64_t)src.st_size
+		&& head.width > 0 && head.height > 0
+		&& fstat(fd, &cached) == 0
+		&& (size_t)cached.st_size == sizeof(head) + (size_t)head.width*head.height*sizeof(pxRGBA);
+	void* base = good? mapPixelFile(fd, cached.st_size) : nullptr;
+	close(fd);
+	if (!base) { return false; }
+	image = ImageRGBA(ImageSpec(head.width, head.height, head.channels, TypeDesc::UINT8), base, cached.st_size, sizeof(head));
+	return true;
+}
+
+/*	saves image as source's cache file (written next to it and renamed over,
+ *	so nobody ever maps a half written one). returns false if it couldn't */
+bool writeRawCached(string source, const ImageRGBA& image) {
+	struct stat src;
+	if (stat(source.c_str(), &src) != 0) { return false; }
+	if (!makeDirs(cacheDir())) {
+		cerr << "could not make raw cache directory " << cacheDir() << endl;
+		return false;
+	}
+	RawHeader head;
+	memset(&head, 0, sizeof(head));
+	memcpy(head.magic, RAW_MAGIC, 8);
+	head.version = RAW_VERSION;
+	head.width = image.spec.width;
+	head.height = image.spec.height;
+	head.channels = image.spec.nchannels;
+	head.sourceMtime = src.st_mtime;
+	head.sourceMtimeNsec = MTIME_NSEC(src);
+	head.sourceSize = src.st_size;
+
+	string path = cacheFile(source);
+	string temp = path + "." + to_string(getpid());
+	ofstream out(temp, ios::binary);
+	out.write((const char*)&head, sizeof(head));
+	out.write((const char*)image.pixels, (size_t)image.spec.width*image.spec.height*sizeof(pxRGBA));
+	out.close();
+	if (!out || rename(temp.c_str(), path.c_str()) != 0) {
+		cerr << "could not write raw cache file " << path << endl;
+		remove(temp.c_str());
+		return false;
+	}
+	return true;
+}
+
+/* deletes every cache file, returns how many there were (-1 if the directory can't be read) */
+int clearRawCache() {
+	string dir = cacheDir();
+	DIR* d = opendir(dir.c_str());
+	if (!d) { return (errno == ENOENT)? 0 : -1; }
+	int removed = 0;
+	string ext = RAW_EXT;
+	for (struct dirent* ent = readdir(d); ent; ent = readdir(d)) {
+		string name = string(ent->d_name);
+		if (name.size() > ext.size() && name.compare(name.size()-ext.size(), ext.size(), ext) == 0) {
+			if (remove((dir + "/" + name).c_str()) == 0) { removed++; }
+		}
+	}
+	closedir(d);
+	return removed;
+}
+
+/** COMMANDS **/
+/* true for the flags that manage the raw cache instead of running the program */
+bool isRawCacheCommand(string arg) {
+	return arg == "--rawcache-fill" || arg == "--rawcache-clear";
+}
+
+/*	--rawcache-clear empties the cache, --rawcache-fill decodes every other
+ *	argument (globs expanded) into it. returns the exit code */
+int rawCacheMain(int argc, char* argv[]) {
+	bool clear = false, fill = false;
+	vector<string> args;
+	for (int i=1; i<argc; i++) {
+		string arg = string(argv[i]);
+		if (arg == "--rawcache-clear") { clear = true; }
+		else if (arg == "--rawcache-fill") { fill = true; }
+		else { args.push_back(arg); }
+	}
+	if (clear) {
+		int removed = clearRawCache();
+		if (removed < 0) {
+			cerr << "could not read raw cache directory " << cacheDir() << endl;
+			return 1;
+		}
+		cout << "removed " << removed << " raw cache files from " << cacheDir() << endl;
+	}
+	if (!fill) { return 0; }
+
+	fillMode = true;
+	int failed = 0;
+	for (string& in : expandInputs(args)) {
+		try {
+			ImageRGBA image = readImage(in); //a cache hit maps, a miss decodes & writes
+			cout << "cached " << in << " (" << image.spec.width << "x" << image.spec.height << ")" << endl;
+		}
+		catch (exception& e) { //(error message is inside readImage already)
+			failed++;
+		}
+	}
+	return (failed > 0)? 1 : 0;
+}
@@ -0,0 +1,37 @@
+#ifndef GLOIIO_OB_RAW_H
+#define GLOIIO_OB_RAW_H
+#include "gloiioFuncs.h"
+#include <cstdint>
+
+//environment variable for the raw cache: off = never touch it, on = also add
+//every image that gets decoded, unset = use what's there but don't add to it
+#define RAW_CACHE_ENV "GLOIIO_RAWCACHE"
+//environment variable for where the cache lives ($XDG_CACHE_HOME/gloiio or ~/.cache/gloiio otherwise)
+#define RAW_CACHE_DIR_ENV "GLOIIO_RAWCACHE_DIR"
+//first bytes of every cache file, and the layout version after them
+#define RAW_MAGIC "GLOIIORW"
+#define RAW_VERSION 2
+//cache files end in this
+#define RAW_EXT ".rgba"
+
+//what's at the front of a raw cache file, the pixels come right after it exactly
+//like they are in memory (pxRGBA, bottom row first). 64 bytes so they stay PIXEL_ALIGN'd
+typedef struct raw_header_t {
+	char magic[8]; //RAW_MAGIC
+	uint32_t version; //RAW_VERSION
+	int32_t width, height;
+	int32_t channels; //what the source file had (the pixels always have 4)
+	int64_t sourceMtime; //source file's modification time (s & ns) & size when this was made,
+	int64_t sourceMtimeNsec; //if any of them changed since it's stale
+	int64_t sourceSize;
+	char unused[16];
+} RawHeader;
+
+bool isRawCacheCommand(string);
+int rawCacheMain(int, char**);
+bool mapRawCached(string, ImageRGBA&);
+bool writeRawCached(string, const ImageRGBA&);
+bool rawCacheAdds();
+int clearRawCache();
+
+#endif
@@ -0,0 +1,196 @@
+#include "gloiioSIMD.h"
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+	#define GLOIIO_X86
+	#include <immintrin.h>
+#endif
+
+/** CPU DETECTION **/
+/*	best instruction set this machine can run, capped by GLOIIO_SIMD if set
+ *	(worked out once, every kernel dispatches off of it) */
+SimdLevel simdLevel() {
+	static SimdLevel level = []{
+		SimdLevel best = SIMD_SCALAR;
+#ifdef GLOIIO_X86
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("sse4.1")) { best = SIMD_SSE41; }
+		if (__builtin_cpu_supports("avx2")) { best = SIMD_AVX2; }
+#endif
+		const char* env = getenv(SIMD_ENV);
+		if (env) {
+			SimdLevel cap = best;
+			if (strcmp(env, "scalar") == 0) { cap = SIMD_SCALAR; }
+			else if (strcmp(env, "sse4") == 0) { cap = SIMD_SSE41; }
+			else if (strcmp(env, "avx2") == 0) { cap = SIMD_AVX2; }
+			if (cap < best) { best = cap; }
+		}
+		return best;
+	}();
+	return level;
+}
+
+const char* simdName(SimdLevel level) {
+	switch (level) {
+		case SIMD_SSE41: return "sse4.1";
+		case SIMD_AVX2: return "avx2";
+		default: return "scalar";
+	}
+}
+
+/** FIXED POINT CONVOLUTION **/
+/*	quantizes a filter for convolveFixedRows
+ *	weights are divided by filt.scale first so every one of them is within -1~1 */
+FixedKernel quantizeFilter(RawFilter filt) {
+	FixedKernel fk;
+	int n = filt.size;
+	int nind = n-1;
+	fk.size = n;
+	fk.stride = (n+1) & ~1;
+	fk.weights = new int16_t[n*fk.stride];
+	for (int row=0; row<n; row++) {
+		for (int col=0; col<fk.stride; col++) {
+			double w = 0.0;
+			if (col < n && filt.scale != 0.0) {
+				//flipped the same way convolve flips the double kernel
+				w = filt.kernel[contigIndex(nind-row,nind-col,n)] / filt.scale;
+			}
+			fk.weights[contigIndex(row,col,fk.stride)] = (int16_t)lround(w*(1<<FIXED_SHIFT));
+		}
+	}
+	return fk;
+}
+
+void discardFixedKernel(FixedKernel fk) {
+	delete[] fk.weights;
+}
+
+/* plain C version, also handles the columns the vector loops can't reach */
+static void fixedSpanScalar(FixedKernel fk, const ImageRGBA& victim, pxRGBA* result, int irow, int x0, int x1) {
+	int n = fk.size;
+	int half = n/2;
+	int iwidth = victim.spec.width;
+	for (int icol=x0; icol<x1; icol++) {
+		int32_t totalRed = 0, totalGreen = 0, totalBlue = 0;
+		for (int frow=0; frow<n; frow++) {
+			const pxRGBA* tap = &victim.pixels[contigIndex(irow+frow-half,icol-half,iwidth)];
+			const int16_t* w = &fk.weights[contigIndex(frow,0,fk.stride)];
+			for (int fcol=0; fcol<n; fcol++) {
+				totalRed += tap[fcol].red * w[fcol];
+				totalGreen += tap[fcol].green * w[fcol];
+				totalBlue += tap[fcol].blue * w[fcol];
+			}
+		}
+		pxRGBA* npx = &result[contigIndex(irow,icol,iwidth)];
+		npx->red = clampInt(totalRed >> FIXED_SHIFT, 0, MAX_VAL);
+		npx->green = clampInt(totalGreen >> FIXED_SHIFT, 0, MAX_VAL);
+		npx->blue = clampInt(totalBlue >> FIXED_SHIFT, 0, MAX_VAL);
+		npx->alpha = victim.pixels[contigIndex(irow,icol,iwidth)].alpha; //don't touch alpha
+	}
+}
+
+#ifdef GLOIIO_X86
+/*	SSE4.1: one output pixel per iteration, two taps per multiply-add
+ *	the 8 bytes of two neighboring taps get shuffled into RRGGBBAA 16 bit pairs
+ *	so pmaddwd does tap0*w0 + tap1*w1 for all four channels at once.
+ *	reads one pixel past the window on odd sizes (weight 0), so x1+half < width */
+__attribute__((target("sse4.1")))
+static void fixedSpanSSE41(FixedKernel fk, const ImageRGBA& victim, pxRGBA* result, int irow, int x0, int x1) {
+	int n = fk.size;
+	int half = n/2;
+	int iwidth = victim.spec.width;
+	const __m128i pairUp = _mm_setr_epi8(0,-1,4,-1, 1,-1,5,-1, 2,-1,6,-1, 3,-1,7,-1);
+	for (int icol=x0; icol<x1; icol++) {
+		__m128i acc = _mm_setzero_si128();
+		for (int frow=0; frow<n; frow++) {
+			const pxRGBA* tap = &victim.pixels[contigIndex(irow+frow-half,icol-half,iwidth)];
+			const int16_t* w = &fk.weights[contigIndex(frow,0,fk.stride)];
+			for (int fcol=0; fcol<fk.stride; fcol+=2) {
+				__m128i px = _mm_shuffle_epi8(_mm_loadl_epi64((const __m128i*)&tap[fcol]), pairUp);
+				int32_t wpair = (int32_t)(((uint32_t)(uint16_t)w[fcol+1] << 16) | (uint16_t)w[fcol]); //shifted unsigned, w can be negative
+				acc = _mm_add_epi32(acc, _mm_madd_epi16(px, _mm_set1_epi32(wpair)));
+			}
+		}
+		//shift out the fraction, saturate down to 8 bits
+		acc = _mm_srai_epi32(acc, FIXED_SHIFT);
+		__m128i words = _mm_packs_epi32(acc, acc);
+		__m128i packed = _mm_packus_epi16(words, words);
+		int iindex = contigIndex(irow,icol,iwidth);
+		pxRGBA npx;
+		memcpy(&npx, &packed, sizeof(pxRGBA)); //low 4 bytes are RGBA
+		npx.alpha = victim.pixels[iindex].alpha; //don't touch alpha
+		result[iindex] = npx;
+	}
+}
+
+/*	AVX2: same pairing trick, two output pixels per iteration
+ *	the low 128 bits work on pixel icol and the high 128 bits on icol+1, both fed
+ *	from one 16 byte load. reads two pixels past the window, so x1+half+1 < width */
+__attribute__((target("avx2")))
+static void fixedSpanAVX2(FixedKernel fk, const ImageRGBA& victim, pxRGBA* result, int irow, int x0, int x1) {
+	int n = fk.size;
+	int half = n/2;
+	int iwidth = victim.spec.width;
+	const __m256i pairUp = _mm256_setr_epi8(0,-1,4,-1, 1,-1,5,-1, 2,-1,6,-1, 3,-1,7,-1,
+		4,-1,8,-1, 5,-1,9,-1, 6,-1,10,-1, 7,-1,11,-1);
+	int icol = x0;
+	for (; icol+1<x1; icol+=2) {
+		__m256i acc = _mm256_setzero_si256();
+		for (int frow=0; frow<n; frow++) {
+			const pxRGBA* tap = &victim.pixels[contigIndex(irow+frow-half,icol-half,iwidth)];
+			const int16_t* w = &fk.weights[contigIndex(frow,0,fk.stride)];
+			for (int fcol=0; fcol<fk.stride; fcol+=2) {
+				__m128i quad = _mm_loadu_si128((const __m128i*)&tap[fcol]);
+				__m256i px = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(quad), pairUp);
+				int32_t wpair = (int32_t)(((uint32_t)(uint16_t)w[fcol+1] << 16) | (uint16_t)w[fcol]); //shifted unsigned, w can be negative
+				acc = _mm256_add_epi32(acc, _mm256_madd_epi16(px, _mm256_set1_epi32(wpair)));
+			}
+		}
+		acc = _mm256_srai_epi32(acc, FIXED_SHIFT);
+		__m128i lo = _mm256_castsi256_si128(acc);
+		__m128i hi = _mm256_extracti128_si256(acc, 1);
+		__m128i words = _mm_packs_epi32(lo, hi);
+		__m128i packed = _mm_packus_epi16(words, words);
+		int iindex = contigIndex(irow,icol,iwidth);
+		pxRGBA npx[2];
+		memcpy(npx, &packed, 2*sizeof(pxRGBA)); //low 8 bytes are both pixels
+		npx[0].alpha = victim.pixels[iindex].alpha; //don't touch alpha
+		npx[1].alpha = victim.pixels[iindex+1].alpha;
+		result[iindex] = npx[0];
+		result[iindex+1] = npx[1];
+	}
+	//odd pixel out
+	if (icol < x1) {
+		fixedSpanSSE41(fk, victim, result, irow, icol, x1);
+	}
+}
+#endif
+
+/*	fixed point convolution of rows y0~y1 of the image interior
+ *	(columns whose window is inside the image), written into result.
+ *	integer accumulators, saturated to 0~MAX_VAL, alpha copied through.
+ *	picks the widest instruction set from simdLevel() */
+void convolveFixedRows(FixedKernel fk, const ImageRGBA& victim, pxRGBA* result, int y0, int y1) {
+	int half = fk.size/2;
+	int iwidth = victim.spec.width;
+	int x0 = half;
+	int x1 = iwidth-half;
+	if (x1 <= x0) { return; }
+	SimdLevel level = simdLevel();
+	for (int irow=y0; irow<y1; irow++) {
+		int vx1 = x0; //end of the columns the vector loop can safely load for
+#ifdef GLOIIO_X86
+		if (level == SIMD_AVX2) {
+			vx1 = iwidth-half-2;
+			if (vx1 > x0) { fixedSpanAVX2(fk, victim, result, irow, x0, vx1); }
+		}
+		else if (level == SIMD_SSE41) {
+			vx1 = iwidth-half-1;
+			if (vx1 > x0) { fixedSpanSSE41(fk, victim, result, irow, x0, vx1); }
+		}
+#endif
+		if (vx1 < x0) { vx1 = x0; }
+		fixedSpanScalar(fk, victim, result, irow, vx1, x1);
+	}
+}
@@ -0,0 +1,36 @@
+#ifndef GLOIIO_OB_SIMD_H
+#define GLOIIO_OB_SIMD_H
+#include "gloiioFuncs.h"
+#include <cstdint>
+
+//environment variable that caps the instruction set (scalar, sse4, avx2)
+#define SIMD_ENV "GLOIIO_SIMD"
+//fractional bits of the quantized convolution weights (Q1.14 fits int16)
+#define FIXED_SHIFT 14
+
+//instruction sets the vectorized kernels are built for, in increasing order
+typedef enum simd_level_t {
+	SIMD_SCALAR,
+	SIMD_SSE41,
+	SIMD_AVX2
+} SimdLevel;
+
+/*	convolution kernel quantized to 16 bit fixed point
+ *	weights are already divided by the filter scale and flipped like tempkern,
+ *	each row is padded with a zero weight to an even length so taps go in pairs.
+ *	error vs the double path: each weight is off by at most 2^-15, so a pixel is
+ *	off by at most 255*N^2/2^15 before truncation, i.e. within 1 LSB up to 11x11
+ *	and within ceil(255*N^2/2^15) LSB beyond that */
+typedef struct fixed_kernel_t {
+	int size; //NxN
+	int stride; //weights per row (N rounded up to even)
+	int16_t* weights;
+} FixedKernel;
+
+SimdLevel simdLevel();
+const char* simdName(SimdLevel);
+FixedKernel quantizeFilter(RawFilter);
+void discardFixedKernel(FixedKernel);
+void convolveFixedRows(FixedKernel, const ImageRGBA&, pxRGBA*, int, int);
+
+#endif
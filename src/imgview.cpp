@@ -4,20 +4,31 @@
 //
 //   Load images at launch by including their file paths as arguments
 //   ** Left/right arrows swap between multiple loaded images **
+//   (only headers are read at launch, images get decoded when they're first shown
+//   and the least recently shown ones are dropped past --cache MB of pixels)
 //
 //   R: read new image from file (prompt)
 //   W: write current image to file (prompt)
 //   I: invert colors of current image
 //   N: randomly add black noise to current image
+//   +/-, mouse wheel: zoom in/out (the wheel zooms around the cursor)
+//   drag with the left mouse button: pan around
+//   F: fit the image to the window, 1: back to 100%
+//   Z: resize the window to fit the image (as much as the screen allows)
 //   ** P: display the first set of bytes of the image data in hex **
 //   
 //   Q or ESC: quit program
 //
 //   CPSC 4040 | Owen Book | September 2022
 //
-//   usage: imgview [filenames]
+//   usage: imgview (--cache mb) [filenames]
+//          imgview --rawcache-fill [filenames] | --rawcache-clear
 //
 #include "gloiioFuncs.h"
+#include "gloiioDisplay.h"
+#include "gloiioPyramid.h"
+#include "gloiioCache.h"
+#include "gloiioRaw.h"
 #include <OpenImageIO/imageio.h>
 #include <iostream>
 #include <string>
@@ -37,49 +48,109 @@ OIIO_NAMESPACE_USING
 //default window dimensions
 #define DEFAULT_WIDTH 600	
 #define DEFAULT_HEIGHT 600
+//zoom per mouse wheel click, and the most it will zoom in
+#define ZOOM_STEP 1.25
+#define MAX_ZOOM 64.0
 
 /** CONTROL & GLOBAL STATICS **/
-//list of read images for multi-image viewing mode
-static vector<ImageRGBA> imageCache;
+//images for multi-image viewing mode live in the image cache (gloiioCache.h), by index
 //current index in vector to attempt to load (left/right arrows)
 static int imageIndex = 0;
 //noisify chance (1/noiseDenom to replace with black pixel)
 static int noiseDenom = 5;
 //frame counter, currently only used for better random generation
 static int drawCount = 0;
+//resolution pyramid of the shown image, levels get made when zoomed out
+static ImagePyramid pyramid;
+//window pixels per image pixel, and the image pixel at the window's bottom left
+static double zoom = 1.0;
+static double viewX = 0.0, viewY = 0.0;
+//where the mouse was last seen while dragging (-1 = not dragging)
+static int dragX = -1, dragY = -1;
 
 
 /** OPENGL FUNCTIONS **/
-/* main display callback: displays the image of current index from imageCache. 
+/* main display callback: displays the image of current index from the image cache. 
 if no images are loaded, only draws a black background */
 void draw(){
 	//clear and make black background
 	glClearColor(0,0,0,1);
 	glClear(GL_COLOR_BUFFER_BIT);
-	if (imageCache.size() > 0) {
-		//display alphamasked image properly via blending
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glEnable(GL_BLEND);
-		//get image spec & current window size
-		ImageSpec* spec = &imageCache[imageIndex].spec;
-		glPixelZoom(1.0,1.0);
-		glPixelStorei(GL_UNPACK_ALIGNMENT, 1); //Parrot Fixer 2000
-		glRasterPos2i(0,0); //draw from bottom left
-		//draw image
-		glDrawPixels(spec->width,spec->height,GL_RGBA,GL_UNSIGNED_BYTE,&imageCache[imageIndex].pixels[0]);
-		glDisable(GL_BLEND);
-	}
+	//the image, uploading whatever changed since the last draw (see gloiioDisplay.h)
+	displayDraw();
 	//increment draws count
 	drawCount++;
 	//flush to viewport
 	glFlush();
 }
 
-/* resets the window size to fit the current image exactly */
+/* tells the display where we're looking */
+void updateView() {
+	displayView(zoom, viewX, viewY);
+}
+
+/* zooms by factor keeping the image point under window pixel (wx,wy) in place */
+void zoomAt(double factor, double wx, double wy) {
+	if (cacheCount() == 0) { return; }
+	double smallest = 1.0/(1 << pyramidDepth(pyramid)); //whole image in a pixel or so
+	double newZoom = zoom*factor;
+	if (newZoom < smallest) { newZoom = smallest; }
+	if (newZoom > MAX_ZOOM) { newZoom = MAX_ZOOM; }
+	viewX += wx/zoom - wx/newZoom;
+	viewY += wy/zoom - wy/newZoom;
+	zoom = newZoom;
+	updateView();
+}
+
+/* zooms so the whole current image fits in the window, centered */
+void fitView() {
+	if (cacheCount() == 0) { return; }
+	ImageSpec spec = cacheSpec(imageIndex);
+	int winW = glutGet(GLUT_WINDOW_WIDTH);
+	int winH = glutGet(GLUT_WINDOW_HEIGHT);
+	double zx = (double)winW/spec.width;
+	double zy = (double)winH/spec.height;
+	zoom = (zx < zy)? zx : zy;
+	viewX = (spec.width - winW/zoom)/2;
+	viewY = (spec.height - winH/zoom)/2;
+	updateView();
+}
+
+/*	shows the current image: 100% from the bottom left if it fits in the window, otherwise fit to it
+ *	it gets decoded first if it isn't in memory, and its neighbors get decoded in the
+ *	background so the arrow keys don't have to wait for them */
+void showCurrent() {
+	if (cacheCount() == 0) { return; }
+	ImageRGBA* image = cacheImage(imageIndex);
+	pyramid = image? makePyramid(*image) : ImagePyramid(); //nothing to show if it couldn't be read
+	displayPyramid(pyramid);
+	cachePrefetch(imageIndex+1);
+	cachePrefetch(imageIndex-1);
+	ImageSpec spec = cacheSpec(imageIndex);
+	if (spec.width > glutGet(GLUT_WINDOW_WIDTH) || spec.height > glutGet(GLUT_WINDOW_HEIGHT)) {
+		fitView();
+	}
+	else {
+		zoom = 1.0;
+		viewX = viewY = 0.0;
+		updateView();
+	}
+}
+
+/* resets the window size to fit the current image exactly (or as close as the screen allows, zoomed to fit) */
 void refitWindow() {
-	if (imageCache.size() > 0) {
-		ImageSpec* spec = &imageCache[imageIndex].spec;
-		glutReshapeWindow(spec->width, spec->height);
+	if (cacheCount() > 0) {
+		ImageSpec spec = cacheSpec(imageIndex);
+		int screenW = glutGet(GLUT_SCREEN_WIDTH)*9/10;
+		int screenH = glutGet(GLUT_SCREEN_HEIGHT)*9/10;
+		if (screenW <= 0 || screenH <= 0) { screenW = spec.width; screenH = spec.height; } //no idea, trust the image
+		double shrink = 1.0;
+		if (spec.width > screenW) { shrink = (double)screenW/spec.width; }
+		if (spec.height*shrink > screenH) { shrink = (double)screenH/spec.height; }
+		glutReshapeWindow((int)(spec.width*shrink), (int)(spec.height*shrink));
+		zoom = shrink;
+		viewX = viewY = 0.0;
+		updateView();
 	}
 }
 
@@ -100,30 +171,61 @@ void handleKey(unsigned char key, int x, int y){
 		case 'R':
 			cout << "enter input filename: ";
 			cin >> fn;
-			try {
-				imageCache.push_back(readImage(fn));
-				imageIndex = imageCache.size()-1;
+			{
+				int index = cacheAdd(fn);
+				if (index >= 0) {
+					imageIndex = index;
+					showCurrent();
+				} //(error message is inside cacheAdd already)
 			}
-			catch (exception &e) {} //(error message is inside readImage already)
 			break;
 		
 		case 'w':
 		case 'W':
 			cout << "enter output filename: ";
 			cin >> fn;
-			writeImage(fn, imageCache[imageIndex]);
+			if (cacheImage(imageIndex)) {
+				writeImage(fn, *cacheImage(imageIndex));
+			}
 			break;
 
 		case 'i':
 		case 'I':
-			invert(imageCache[imageIndex]);
+			if (cacheImage(imageIndex)) {
+				invert(*cacheImage(imageIndex));
+				cacheEdited(imageIndex); //so it doesn't get evicted and lose it
+				displayDirty();
+			}
 			break;
 		
 		case 'n':
 		case 'N':
-			noisify(imageCache[imageIndex], noiseDenom, drawCount);
+			if (cacheImage(imageIndex)) {
+				noisify(*cacheImage(imageIndex), noiseDenom, drawCount);
+				cacheEdited(imageIndex);
+				displayDirty();
+			}
 			break;
 		
+		case '+':
+		case '=':
+			zoomAt(2.0, glutGet(GLUT_WINDOW_WIDTH)/2.0, glutGet(GLUT_WINDOW_HEIGHT)/2.0);
+			break;
+
+		case '-':
+		case '_':
+			zoomAt(0.5, glutGet(GLUT_WINDOW_WIDTH)/2.0, glutGet(GLUT_WINDOW_HEIGHT)/2.0);
+			break;
+
+		case 'f':
+		case 'F':
+			fitView();
+			break;
+
+		case '1':
+			zoomAt(1.0/zoom, glutGet(GLUT_WINDOW_WIDTH)/2.0, glutGet(GLUT_WINDOW_HEIGHT)/2.0);
+			break;
+
 		case 'q':		// q - quit
 		case 'Q':
 		case 27:		// esc - quit
@@ -137,17 +239,19 @@ void handleKey(unsigned char key, int x, int y){
 void specialKey(int key, int x, int y) {
 	switch(key) {
 		case GLUT_KEY_LEFT:
-			//cout << "was displaying image " << imageIndex+1 << " of " << imageCache.size() << endl;
+			//cout << "was displaying image " << imageIndex+1 << " of " << cacheCount() << endl;
 			if (imageIndex > 0) {
 				imageIndex--;
-				cout << "image " << imageIndex+1 << " of " << imageCache.size() << endl;
+				cout << "image " << imageIndex+1 << " of " << cacheCount() << endl;
+				showCurrent();
 			}
 			break;
 		case GLUT_KEY_RIGHT:
-			//cout << "was displaying image " << imageIndex+1 << " of " << imageCache.size() << endl;
-			if (imageIndex < imageCache.size()-1 && imageCache.size() > 0) {
+			//cout << "was displaying image " << imageIndex+1 << " of " << cacheCount() << endl;
+			if (imageIndex < cacheCount()-1) {
 				imageIndex++;
-				cout << "image " << imageIndex+1 << " of " << imageCache.size() << endl;
+				cout << "image " << imageIndex+1 << " of " << cacheCount() << endl;
+				showCurrent();
 			}
 			break;
 		default:
@@ -155,6 +259,31 @@ void specialKey(int key, int x, int y) {
 	}
 }
 
+/* mouse buttons: the wheel zooms around the cursor, the left button starts a drag */
+void handleMouse(int button, int state, int x, int y) {
+	int wy = glutGet(GLUT_WINDOW_HEIGHT)-y; //GLUT counts from the top
+	if (button == GLUT_LEFT_BUTTON) {
+		dragX = (state == GLUT_DOWN)? x : -1;
+		dragY = (state == GLUT_DOWN)? y : -1;
+	}
+	else if (state == GLUT_DOWN && button == 3) { //wheel up
+		zoomAt(ZOOM_STEP, x, wy);
+	}
+	else if (state == GLUT_DOWN && button == 4) { //wheel down
+		zoomAt(1.0/ZOOM_STEP, x, wy);
+	}
+}
+
+/* dragging pans the image along with the mouse */
+void handleDrag(int x, int y) {
+	if (dragX < 0) { return; }
+	viewX -= (x-dragX)/zoom;
+	viewY += (y-dragY)/zoom;
+	dragX = x;
+	dragY = y;
+	updateView();
+}
+
 /*
    Reshape Callback Routine: sets up the viewport and drawing coordinates
    This routine is called when the window is created and every time the window
@@ -170,20 +299,21 @@ void handleReshape(int w, int h){
   gluOrtho2D(0, w, 0, h);
 }
 
-/* timer function to make the OS always update the window 
-	(fixes hang on launch...)*/
-void timer( int value )
-{
-    glutPostRedisplay();
-    glutTimerFunc( 33, timer, 0 );
-}
-
 /* main control method that sets up the GL environment
 	and handles command line arguments */
 int main(int argc, char* argv[]){
-	//read arguments as filenames and attempt to read requested files
+	//read arguments as filenames, only their headers for now (pixels come when they're shown)
 	for (int i=1; i<argc; i++) {
-		imageCache.push_back(readImage(string(argv[i])));
+		string arg = string(argv[i]);
+		if (isRawCacheCommand(arg)) {
+			return rawCacheMain(argc, argv);
+		}
+		else if (arg == "--cache" && i+1 < argc) {
+			setCacheBudget((size_t)stoi(argv[++i],nullptr)*1024*1024);
+		}
+		else if (cacheAdd(arg) < 0) {
+			cerr << "skipping " << arg << endl;
+		}
 	}
 	//always display first image on load
 	imageIndex = 0;
@@ -195,14 +325,16 @@ int main(int argc, char* argv[]){
 	glutInitDisplayMode(GLUT_SINGLE | GLUT_RGBA);
 	glutInitWindowSize(DEFAULT_WIDTH, DEFAULT_HEIGHT);
 	glutCreateWindow("Get the Picture");
+	showCurrent();
 
 	// set up the callback routines to be called when glutMainLoop() detects
 	// an event
 	glutDisplayFunc(draw);	  // display callback
 	glutKeyboardFunc(handleKey);	  // keyboard callback
 	glutSpecialFunc(specialKey); //special callback (arrow keys, etc.)
+	glutMouseFunc(handleMouse); //zoom with the wheel
+	glutMotionFunc(handleDrag); //pan by dragging
 	glutReshapeFunc(handleReshape); // window resize callback
-	glutTimerFunc(0, timer, 0); //timer func to force redraws
 
 	// Routine that loops forever looking for events. It calls the registered
 	// callback routine to handle each event that is detected
@@ -0,0 +1,62 @@
+//	pipeline: headless program that runs a chain of operations on an image
+//	in one read, one write and one pass over memory
+//
+//	Usage: pipeline [input] [output] [stage] (stage...)
+//	stages: invert | noise:denom | key:h,s,v(,fuzzh,fuzzs,fuzzv)
+//	        over:background | convolve:filter.filt(,edge)
+//	See README.md for more details
+//
+//	CPSC 4040 | Owen Book
+#include "gloiioFuncs.h"
+#include "gloiioPipeline.h"
+#include "gloiioPool.h"
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <exception>
+
+using namespace std;
+OIIO_NAMESPACE_USING;
+
+int main(int argc, char* argv[]) {
+	//pull out option flags, everything else is read in order
+	vector<string> args;
+	for (int i=1; i<argc; i++) {
+		string arg = string(argv[i]);
+		if ((arg == "-t" || arg == "--threads") && i+1 < argc) {
+			setThreadCount(stoi(argv[++i],nullptr));
+		}
+		else {
+			args.push_back(arg);
+		}
+	}
+	if (args.size() < 3) {
+		cerr << "usage: pipeline (-t threads) [input] [output] [stage] (stage...)" << endl;
+		cerr << "stages: invert | noise:denom | key:h,s,v(,fuzzh,fuzzs,fuzzv) | over:background | convolve:filter.filt(,edge)" << endl;
+		exit(1);
+	}
+
+	vector<PipelineStage> stages;
+	try {
+		for (size_t i=2; i<args.size(); i++) {
+			stages.push_back(parseStage(args[i]));
+		}
+		ImageRGBA image = readImage(args[0]);
+
+		chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+		ImageRGBA result = runPipeline(stages, image);
+		double ms = chrono::duration<double,milli>(chrono::steady_clock::now()-t0).count();
+		double mp = (double)image.spec.width*image.spec.height/1e6;
+		cout << stages.size() << " stages over " << mp << " MP in " << ms << " ms ("
+			<< mp/(ms/1000.0) << " MP/s)" << endl;
+
+		bool ok = writeImage(args[1], result);
+		discardImage(result);
+		discardImage(image);
+		for (PipelineStage& stage : stages) { discardStage(stage); }
+		return ok? 0 : 1;
+	}
+	catch (exception &e) {
+		return 1; //(error message is printed where it happened)
+	}
+}